@@ -0,0 +1,51 @@
+// 对比两次 micro_bench 的输出：按 bench + size 配对，打印 ns_per_op 的变化，
+// 变慢超过阈值（默认 10%）的行标出 REGRESSION，有回退时退出码为 1。
+// 用法: bench_compare old.jsonl new.jsonl [threshold_percent]
+#include <fstream>
+#include <map>
+
+#include <jsoncpp/json/json.h>
+
+typedef std::map<std::pair<std::string, uint64_t>, double> Results;
+
+bool Load(const char *path, Results *results)
+{
+    std::ifstream in(path);
+    if (!in) {
+        fprintf(stderr, "open %s failed\n", path);
+        return false;
+    }
+    std::string line;
+    Json::Reader reader;
+    while (std::getline(in, line)) {
+        Json::Value item;
+        if (line.empty() || !reader.parse(line, item) || !item.isMember("bench")) continue;
+        (*results)[{item["bench"].asString(), item["size"].asUInt64()}] = item["ns_per_op"].asDouble();
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s old.jsonl new.jsonl [threshold_percent]\n", argv[0]);
+        return 2;
+    }
+    double threshold = argc > 3 ? atof(argv[3]) : 10;
+    Results before, after;
+    if (!Load(argv[1], &before) || !Load(argv[2], &after)) return 2;
+
+    int regressions = 0;
+    printf("%-32s %12s %14s %14s %9s\n", "bench", "size", "old ns/op", "new ns/op", "change");
+    for (auto &item : after) {
+        auto old = before.find(item.first);
+        if (old == before.end()) continue;
+        double change = (item.second - old->second) / old->second * 100;
+        bool regressed = change > threshold;
+        regressions += regressed;
+        printf("%-32s %12llu %14.1f %14.1f %+8.1f%%%s\n", item.first.first.c_str(),
+               (unsigned long long)item.first.second, old->second, item.second, change,
+               regressed ? "  REGRESSION" : "");
+    }
+    return regressions > 0 ? 1 : 0;
+}
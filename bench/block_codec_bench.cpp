@@ -0,0 +1,104 @@
+// 分块并行压缩基准：对 bundle 的每种编码，分别用 1, 2, 4 ... 个线程把同一份数据
+// 压成分块容器再解压回来，每个组合输出一行 JSON（压缩/解压 MB/s 和压缩率）
+// 用法: block_codec_bench [size_mb] [block_kb] [max_threads] [codec,...]
+// codec 是 bundle 的编码编号或名字，默认 LZ4,ZSTD,MINIZ,LZIP,LZMA20,BROTLI9
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <sstream>
+
+#include "../block_container.hpp"
+#include "../../LogSystem/utils.hpp"
+#include "../../LogSystem/manage.hpp"
+
+void log_system_module_init()
+{
+    std::shared_ptr<wwlog::LoggerBuilder> logger_builder(new wwlog::LoggerBuilder());
+    logger_builder->SetLoggerName("asynclogger");
+    logger_builder->AddLoggerFlush<wwlog::FileFlush>("./bench.log");
+    logger_builder->SetThreadPool(std::shared_ptr<ThreadPool>(new ThreadPool(1)));
+    wwlog::LoggerManager::GetInstance().AddLogger(logger_builder->Build());
+}
+
+double ElapsedSec(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// 近似文本的可压缩数据：从一个小词表里随机取词
+std::string MakeInput(size_t size)
+{
+    const char *words[] = {"storage ", "deep ", "low ", "upload ", "download ", "block ", "bundle ",
+                           "relay ",   "file ", "index ", "journal ", "cache ", "\n",       "0123 "};
+    std::string input;
+    input.reserve(size + 16);
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    while (input.size() < size) {
+        seed ^= seed << 13, seed ^= seed >> 7, seed ^= seed << 17;
+        input += words[seed % (sizeof(words) / sizeof(words[0]))];
+    }
+    input.resize(size);
+    return input;
+}
+
+int CodecOf(const std::string &name)
+{
+    if (!name.empty() && isdigit(name[0])) return atoi(name.c_str());
+    for (int q = 0; q <= bundle::BZIP2; q++) {
+        if (name == bundle::name_of((unsigned)q)) return q;
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t size = (argc > 1 ? strtoull(argv[1], nullptr, 10) : 64) * 1024 * 1024;
+    size_t block_size = (argc > 2 ? strtoull(argv[2], nullptr, 10) : 1024) * 1024;
+    int max_threads = argc > 3 ? atoi(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+    std::string codecs = argc > 4 ? argv[4] : "LZ4,ZSTD,MINIZ,LZIP,LZMA20,BROTLI9";
+
+    char dir[] = "/tmp/filerelay-bench-XXXXXX";
+    if (mkdtemp(dir) == nullptr || chdir(dir) == -1) {
+        perror("mkdtemp");
+        return 1;
+    }
+    log_system_module_init();
+
+    std::string input = MakeInput(size);
+    wwstorage::File("./input").SetContent(input.c_str(), input.size());
+
+    std::stringstream ss(codecs);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        int codec = CodecOf(name);
+        if (codec < 0) {
+            fprintf(stderr, "unknown codec: %s\n", name.c_str());
+            continue;
+        }
+        for (int threads = 1; threads <= max_threads; threads *= 2) {
+            auto start = std::chrono::steady_clock::now();
+            bool ok = wwstorage::BlockWriter::CompressFile("./input", "./packed", codec, block_size, threads);
+            double compress = ElapsedSec(start);
+
+            wwstorage::BlockReader reader;
+            reader.SetThreads(threads);
+            start = std::chrono::steady_clock::now();
+            ok = ok && reader.Open("./packed") && reader.DecodeTo("./output");
+            double decompress = ElapsedSec(start);
+
+            std::string output;
+            ok = ok && wwstorage::File("./output").GetContent(&output) && output == input;
+            double mb = size / (1024.0 * 1024.0);
+            printf("{\"bench\":\"block_codec\",\"codec\":\"%s\",\"threads\":%d,\"block_kb\":%zu,\"size_mb\":%.0f,"
+                   "\"ratio\":%.4f,\"compress_mb_s\":%.2f,\"decompress_mb_s\":%.2f,\"ok\":%s}\n",
+                   bundle::name_of((unsigned)codec), threads, block_size / 1024, mb,
+                   (double)wwstorage::File("./packed").Size() / size, mb / compress, mb / decompress,
+                   ok ? "true" : "false");
+            fflush(stdout);
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
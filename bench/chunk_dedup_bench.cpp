@@ -0,0 +1,145 @@
+// 分块去重基准：模拟同一份备份的多个版本，每个版本在随机位置插入、删除、覆盖共 edit_mb 数据，
+// 依次写进块仓库，每个版本输出一行 JSON（新增字节、去重率、写入 MB/s），
+// 同时给出同样平均块长的定长分块能去掉多少重复，最后输出一行累计结果
+// 用法: chunk_dedup_bench [size_mb] [versions] [edit_mb] [avg_kb] [threads] [codec]
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <unordered_set>
+
+#include "../chunk_store.hpp"
+#include "../../LogSystem/utils.hpp"
+#include "../../LogSystem/manage.hpp"
+
+void log_system_module_init()
+{
+    std::shared_ptr<wwlog::LoggerBuilder> logger_builder(new wwlog::LoggerBuilder());
+    logger_builder->SetLoggerName("asynclogger");
+    logger_builder->AddLoggerFlush<wwlog::FileFlush>("./bench.log");
+    logger_builder->SetThreadPool(std::shared_ptr<ThreadPool>(new ThreadPool(1)));
+    wwlog::LoggerManager::GetInstance().AddLogger(logger_builder->Build());
+}
+
+double ElapsedSec(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint64_t Next(uint64_t *seed)
+{
+    *seed ^= *seed << 13, *seed ^= *seed >> 7, *seed ^= *seed << 17;
+    return *seed;
+}
+
+// 近似备份的数据：文本词表和随机字节交替，既有可压缩的部分也有不可压缩的部分
+std::string MakeInput(size_t size, uint64_t *seed)
+{
+    const char *words[] = {"storage ", "deep ", "low ", "upload ", "download ", "block ", "bundle ",
+                           "relay ",   "file ", "index ", "journal ", "cache ", "\n",       "0123 "};
+    std::string input;
+    input.reserve(size + 4096);
+    while (input.size() < size) {
+        if (Next(seed) % 4 == 0) {
+            for (int i = 0; i < 4096; i++) input += (char)Next(seed);
+        } else {
+            for (int i = 0; i < 512; i++) input += words[Next(seed) % (sizeof(words) / sizeof(words[0]))];
+        }
+    }
+    input.resize(size);
+    return input;
+}
+
+// 在随机位置做 16 次插入/删除/覆盖，合计约 edit_bytes 字节
+void Mutate(std::string *data, size_t edit_bytes, uint64_t *seed)
+{
+    const int kEdits = 16;
+    size_t each = std::max<size_t>(edit_bytes / kEdits, 1);
+    for (int i = 0; i < kEdits; i++) {
+        size_t pos = Next(seed) % (data->size() - each);
+        std::string patch = MakeInput(each, seed);
+        switch (Next(seed) % 3) {
+            case 0:
+                data->insert(pos, patch);
+                break;
+            case 1:
+                data->erase(pos, each);
+                break;
+            default:
+                data->replace(pos, each, patch);
+                break;
+        }
+    }
+}
+
+// 定长分块时新出现的字节数，用来对比插入/删除后定长切分的块全部错位
+uint64_t FixedFresh(const std::string &data, size_t block_size, std::unordered_set<std::string> *seen)
+{
+    uint64_t fresh = 0;
+    for (size_t pos = 0; pos < data.size(); pos += block_size) {
+        size_t n = std::min(block_size, data.size() - pos);
+        if (seen->insert(wwstorage::Sha256::Hash(data.substr(pos, n))).second) fresh += n;
+    }
+    return fresh;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t size = (argc > 1 ? strtoull(argv[1], nullptr, 10) : 256) * 1024 * 1024;
+    int versions = argc > 2 ? atoi(argv[2]) : 5;
+    size_t edit = (argc > 3 ? strtoull(argv[3], nullptr, 10) : 4) * 1024 * 1024;
+    size_t avg = (argc > 4 ? strtoull(argv[4], nullptr, 10) : 512) * 1024;
+    int threads = argc > 5 ? atoi(argv[5]) : std::max(1u, std::thread::hardware_concurrency());
+    int codec = argc > 6 ? atoi(argv[6]) : bundle::LZ4;
+
+    char dir[] = "/tmp/filerelay-bench-XXXXXX";
+    if (mkdtemp(dir) == nullptr || chdir(dir) == -1) {
+        perror("mkdtemp");
+        return 1;
+    }
+    log_system_module_init();
+
+    wwstorage::ChunkStore store("./chunks/", avg);
+    store.Init({"./manifests/"});
+    wwstorage::File("./manifests/").CreateDirectory();
+    size_t fixed_block = store.Chunker().AvgSize();
+    std::unordered_set<std::string> fixed_seen;
+
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    std::string data = MakeInput(size, &seed);
+    uint64_t logical = 0, fresh_total = 0, fixed_fresh_total = 0;
+    double seconds = 0;
+    for (int v = 0; v < versions; v++) {
+        if (v > 0) Mutate(&data, edit, &seed);
+        std::string manifest = "./manifests/v" + std::to_string(v);
+        wwstorage::ChunkWriter writer(&store, manifest, codec, threads);
+        auto start = std::chrono::steady_clock::now();
+        bool ok = writer.Open() && writer.Write(data.data(), data.size()) && writer.Finish();
+        double elapsed = ElapsedSec(start);
+
+        wwstorage::ChunkReader reader;
+        std::string check;
+        ok = ok && reader.Open(&store, manifest) && reader.ReadRange(0, data.size(), &check) && check == data;
+        uint64_t fixed_fresh = FixedFresh(data, fixed_block, &fixed_seen);
+
+        logical += data.size();
+        fresh_total += writer.FreshBytes();
+        fixed_fresh_total += fixed_fresh;
+        seconds += elapsed;
+        printf("{\"bench\":\"chunk_dedup\",\"version\":%d,\"size_mb\":%.2f,\"chunks\":%zu,\"fresh_mb\":%.2f,"
+               "\"dedup\":%.4f,\"fixed_dedup\":%.4f,\"ingest_mb_s\":%.2f,\"ok\":%s}\n",
+               v, data.size() / 1048576.0, reader.ChunkCount(), writer.FreshBytes() / 1048576.0,
+               1 - (double)writer.FreshBytes() / data.size(), 1 - (double)fixed_fresh / data.size(),
+               data.size() / 1048576.0 / elapsed, ok ? "true" : "false");
+        fflush(stdout);
+    }
+    printf("{\"bench\":\"chunk_dedup_total\",\"avg_kb\":%zu,\"threads\":%d,\"codec\":\"%s\",\"logical_mb\":%.2f,"
+           "\"unique_mb\":%.2f,\"stored_mb\":%.2f,\"dedup_ratio\":%.2f,\"fixed_dedup_ratio\":%.2f,"
+           "\"ingest_mb_s\":%.2f}\n",
+           fixed_block / 1024, threads, bundle::name_of((unsigned)codec), logical / 1048576.0,
+           fresh_total / 1048576.0, store.StoredBytes() / 1048576.0, (double)logical / fresh_total,
+           (double)logical / fixed_fresh_total, logical / 1048576.0 / seconds);
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,376 @@
+// 端到端压测：按 /upload 协议（base64 的 FileName 头和 StorageType 头）上传、按 /download/ 下载，
+// 对本机运行中的 filerelay 施加可配置的并发、文件大小分布、low/deep 比例和读写比例，
+// 每种操作输出一行 JSON：吞吐和 p50/p99/p999 延迟。
+// 先预置 files 个文件供下载，写操作覆盖另一组 files 个文件，压测结束后服务端的存储不会无限增长。
+// 每次上传的内容都不一样，测的是压缩和落盘；-D 让同样大小的上传内容完全相同，测服务端去重（哈希加硬链接）的路径。
+// 用法: filerelay-bench [-h host] [-p port] [-c connections] [-d duration_s] [-n files]
+//                       [-s size:weight,...] [-m deep_percent] [-r read_percent] [-D]
+//   -s 例如 4k:50,64k:30,1m:15,16m:5，按权重随机选文件大小；-m 是 deep 文件所占百分比；-r 是下载所占百分比
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../lib/base64.h"
+
+enum Op { kUploadLow, kUploadDeep, kDownloadLow, kDownloadDeep, kOpCount };
+const char *kOpNames[kOpCount] = {"upload_low", "upload_deep", "download_low", "download_deep"};
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8081;
+    int connections = 16;
+    int duration_s = 10;
+    int files = 64;
+    std::vector<std::pair<uint64_t, int>> sizes = {{4096, 50}, {65536, 30}, {1048576, 15}, {16777216, 5}};
+    int deep_percent = 50;
+    int read_percent = 80;
+    bool dedup = false;
+};
+
+// 每个线程各自记录，结束后合并
+struct Stats {
+    std::vector<uint32_t> latency_us[kOpCount];
+    uint64_t bytes[kOpCount] = {};
+    uint64_t errors[kOpCount] = {};
+};
+
+int Connect(const std::string &host, int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+bool WriteAll(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// 读一个完整响应，body 只计数不保存；返回状态码，body 长度放到 length，出错返回 -1。
+// buffer 里留着下一个响应已经读到的部分
+int ReadResponse(int fd, std::string *buffer, uint64_t *length)
+{
+    size_t header_end;
+    while ((header_end = buffer->find("\r\n\r\n")) == std::string::npos) {
+        char chunk[16384];
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0) return -1;
+        buffer->append(chunk, n);
+    }
+    std::string headers = buffer->substr(0, header_end);
+    for (auto &c : headers) c = tolower(c);
+    if (headers.compare(0, 5, "http/") != 0) return -1;
+    int status = atoi(headers.c_str() + headers.find(' ') + 1);
+    size_t pos = headers.find("content-length:");
+    *length = pos == std::string::npos ? 0 : strtoull(headers.c_str() + pos + 15, nullptr, 10);
+
+    buffer->erase(0, header_end + 4);
+    uint64_t remain = *length;
+    uint64_t buffered = std::min<uint64_t>(remain, buffer->size());
+    buffer->erase(0, buffered);
+    remain -= buffered;
+    static thread_local char chunk[256 * 1024];
+    while (remain > 0) {
+        ssize_t n = read(fd, chunk, std::min<uint64_t>(sizeof(chunk), remain));
+        if (n <= 0) return -1;
+        remain -= n;
+    }
+    return status;
+}
+
+class Client {
+public:
+    Client(const Options &options) : options_(options), fd_(-1) {}
+    ~Client()
+    {
+        if (fd_ != -1) close(fd_);
+    }
+
+    // 返回是否成功，失败后断开连接，下次请求重连。
+    // stamp 非 0 时在 body 每 kStampInterval 字节的开头写上 stamp 再发出去，服务端按内容和按块都去重不了
+    bool Upload(const std::string &name, bool deep, const std::string &body, uint64_t stamp)
+    {
+        std::string head = "POST /upload HTTP/1.1\r\nHost: " + options_.host + "\r\nConnection: keep-alive\r\n" +
+                           "FileName: " + base64_encode(name) + "\r\nStorageType: " + (deep ? "deep" : "low") +
+                           "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n";
+        uint64_t length;
+        return Request(head, &body, stamp, &length) == 200;
+    }
+    bool Download(const std::string &name, uint64_t expected)
+    {
+        std::string head = "GET /download/" + name + " HTTP/1.1\r\nHost: " + options_.host +
+                           "\r\nConnection: keep-alive\r\n\r\n";
+        uint64_t length = 0;
+        return Request(head, nullptr, 0, &length) == 200 && length == expected;
+    }
+
+private:
+    int Request(const std::string &head, const std::string *body, uint64_t stamp, uint64_t *length)
+    {
+        if (fd_ == -1 && (fd_ = Connect(options_.host, options_.port)) == -1) return -1;
+        int status = -1;
+        if (WriteAll(fd_, head.data(), head.size()) && (body == nullptr || WriteBody(*body, stamp))) {
+            status = ReadResponse(fd_, &buffer_, length);
+        }
+        if (status == -1) {
+            close(fd_);
+            fd_ = -1;
+            buffer_.clear();
+        }
+        return status;
+    }
+    // 分段拷到 out_ 里打上 stamp 再写，内存占用和 body 大小无关
+    bool WriteBody(const std::string &body, uint64_t stamp)
+    {
+        if (stamp == 0) return WriteAll(fd_, body.data(), body.size());
+        char mark[kStampBytes + 1];
+        snprintf(mark, sizeof(mark), "%015llx\n", (unsigned long long)stamp);
+        for (size_t off = 0; off < body.size(); off += sizeof(out_)) {
+            size_t n = std::min(sizeof(out_), body.size() - off);
+            memcpy(out_, body.data() + off, n);
+            for (size_t i = 0; i < n; i += kStampInterval) memcpy(out_ + i, mark, std::min(kStampBytes, n - i));
+            if (!WriteAll(fd_, out_, n)) return false;
+        }
+        return true;
+    }
+
+private:
+    static const size_t kStampInterval = 4096;
+    static const size_t kStampBytes = 16;
+
+    const Options &options_;
+    int fd_;
+    std::string buffer_;
+    char out_[256 * 1024];
+};
+
+// 第 i 个文件的名字、层和大小都是确定的，预置和压测两边算出来一样
+struct FileSpec {
+    std::string name;
+    bool deep;
+    uint64_t size;
+};
+
+FileSpec SpecOf(const Options &options, const std::string &prefix, int i)
+{
+    std::mt19937_64 rng(std::hash<std::string>()(prefix) + i);
+    int total = 0;
+    for (auto &s : options.sizes) total += s.second;
+    int pick = rng() % total;
+    uint64_t size = options.sizes.back().first;
+    for (auto &s : options.sizes) {
+        if (pick < s.second) {
+            size = s.first;
+            break;
+        }
+        pick -= s.second;
+    }
+    bool deep = (int)(rng() % 100) < options.deep_percent;
+    return {prefix + std::to_string(i) + (deep ? "-deep" : "-low") + ".bin", deep, size};
+}
+
+// 可压缩的内容：随机的短行，deep 文件的压缩率接近日志一类的文本
+std::string MakeBody(uint64_t size, uint64_t seed)
+{
+    std::string body;
+    body.reserve(size);
+    std::mt19937_64 rng(seed);
+    char line[64];
+    while (body.size() < size) {
+        int n = snprintf(line, sizeof(line), "%llu INFO request %llu done in %llu us\n",
+                         (unsigned long long)(rng() % 100000), (unsigned long long)(rng() % 1000),
+                         (unsigned long long)(rng() % 5000));
+        body.append(line, n);
+    }
+    body.resize(size);
+    return body;
+}
+
+uint64_t ParseSize(const std::string &text)
+{
+    char *end;
+    uint64_t value = strtoull(text.c_str(), &end, 10);
+    switch (tolower(*end)) {
+        case 'k': return value << 10;
+        case 'm': return value << 20;
+        case 'g': return value << 30;
+        default: return value;
+    }
+}
+
+bool ParseOptions(int argc, char *argv[], Options *options)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:c:d:n:s:m:r:D")) != -1) {
+        switch (opt) {
+            case 'h': options->host = optarg; break;
+            case 'p': options->port = atoi(optarg); break;
+            case 'c': options->connections = atoi(optarg); break;
+            case 'd': options->duration_s = atoi(optarg); break;
+            case 'n': options->files = atoi(optarg); break;
+            case 'm': options->deep_percent = atoi(optarg); break;
+            case 'r': options->read_percent = atoi(optarg); break;
+            case 'D': options->dedup = true; break;
+            case 's': {
+                options->sizes.clear();
+                std::stringstream ss(optarg);
+                std::string item;
+                while (std::getline(ss, item, ',')) {
+                    size_t colon = item.find(':');
+                    int weight = colon == std::string::npos ? 1 : atoi(item.c_str() + colon + 1);
+                    if (weight > 0) options->sizes.emplace_back(ParseSize(item.substr(0, colon)), weight);
+                }
+                break;
+            }
+            default: return false;
+        }
+    }
+    return options->connections > 0 && options->files > 0 && !options->sizes.empty();
+}
+
+uint32_t Percentile(const std::vector<uint32_t> &sorted, double p)
+{
+    if (sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))];
+}
+
+void Report(Stats &total, double seconds, const Options &options)
+{
+    for (int op = 0; op < kOpCount; op++) {
+        auto &latency = total.latency_us[op];
+        if (latency.empty() && total.errors[op] == 0) continue;
+        std::sort(latency.begin(), latency.end());
+        printf("{\"bench\":\"filerelay\",\"op\":\"%s\",\"connections\":%d,\"count\":%zu,\"errors\":%llu,"
+               "\"ops_per_s\":%.1f,\"mb_per_s\":%.2f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f,"
+               "\"max_ms\":%.3f}\n",
+               kOpNames[op], options.connections, latency.size(), (unsigned long long)total.errors[op],
+               latency.size() / seconds, total.bytes[op] / seconds / (1024 * 1024), Percentile(latency, 0.5) / 1e3,
+               Percentile(latency, 0.99) / 1e3, Percentile(latency, 0.999) / 1e3,
+               latency.empty() ? 0 : latency.back() / 1e3);
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, &options)) {
+        fprintf(stderr,
+                "usage: %s [-h host] [-p port] [-c connections] [-d duration_s] [-n files] [-s size:weight,...] "
+                "[-m deep_percent] [-r read_percent] [-D]\n",
+                argv[0]);
+        return 1;
+    }
+    // 同一个大小共用一份内容，避免大文件在每个线程里各生成一次；发送时再按 stamp 区分每次上传
+    std::vector<std::string> bodies;
+    for (auto &s : options.sizes) bodies.push_back(MakeBody(s.first, s.first));
+    auto body_of = [&](uint64_t size) -> const std::string & {
+        for (size_t i = 0; i < options.sizes.size(); i++) {
+            if (options.sizes[i].first == size) return bodies[i];
+        }
+        return bodies.back();
+    };
+
+    std::string tag = "filerelay-bench-" + std::to_string(getpid()) + "-";
+    // 带上 pid，和之前几次压测留在服务端的内容也不重复
+    std::atomic<uint64_t> next_stamp(((uint64_t)getpid() << 32) + 1);
+    auto stamp = [&]() -> uint64_t { return options.dedup ? 0 : next_stamp++; };
+    std::string read_prefix = tag + "r", write_prefix = tag + "w";
+    fprintf(stderr, "preloading %d files...\n", options.files);
+    {
+        std::vector<std::thread> loaders;
+        std::atomic<int> next(0), failed(0);
+        for (int c = 0; c < std::min(options.connections, options.files); c++) {
+            loaders.emplace_back([&]() {
+                Client client(options);
+                for (int i; (i = next++) < options.files;) {
+                    FileSpec spec = SpecOf(options, read_prefix, i);
+                    if (!client.Upload(spec.name, spec.deep, body_of(spec.size), stamp())) failed++;
+                }
+            });
+        }
+        for (auto &loader : loaders) loader.join();
+        if (failed > 0) {
+            fprintf(stderr, "preload failed for %d files, is filerelay running on %s:%d?\n", failed.load(),
+                    options.host.c_str(), options.port);
+            return 1;
+        }
+    }
+
+    std::atomic<bool> start(false), stop(false);
+    std::vector<Stats> stats(options.connections);
+    std::vector<std::thread> clients;
+    for (int c = 0; c < options.connections; c++) {
+        clients.emplace_back([&, c]() {
+            Client client(options);
+            Stats &local = stats[c];
+            std::mt19937_64 rng(c);
+            while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed)) {
+                bool read = (int)(rng() % 100) < options.read_percent;
+                FileSpec spec = SpecOf(options, read ? read_prefix : write_prefix, rng() % options.files);
+                int op = read ? (spec.deep ? kDownloadDeep : kDownloadLow) : (spec.deep ? kUploadDeep : kUploadLow);
+                auto begin = std::chrono::steady_clock::now();
+                bool ok = read ? client.Download(spec.name, spec.size)
+                               : client.Upload(spec.name, spec.deep, body_of(spec.size), stamp());
+                auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                                 begin).count();
+                if (!ok) {
+                    local.errors[op]++;
+                    continue;
+                }
+                local.latency_us[op].push_back(us);
+                local.bytes[op] += spec.size;
+            }
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::seconds(options.duration_s));
+    stop.store(true);
+    for (auto &client : clients) client.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    Stats total;
+    for (auto &local : stats) {
+        for (int op = 0; op < kOpCount; op++) {
+            total.latency_us[op].insert(total.latency_us[op].end(), local.latency_us[op].begin(),
+                                        local.latency_us[op].end());
+            total.bytes[op] += local.bytes[op];
+            total.errors[op] += local.errors[op];
+        }
+    }
+    Report(total, seconds, options);
+    return 0;
+}
@@ -0,0 +1,127 @@
+// HTTP 吞吐基准：若干个 keep-alive 连接各用一个线程循环 GET 同一个 path，输出每个并发度的一行 JSON。
+// 用 worker_threads = 1, 2, 4 ... 分别启动 filerelay 后运行，对比 rps 随核数的变化
+// 用法: http_throughput_bench <host> <port> <path> [connections,...] [duration_ms]
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+int Connect(const std::string &host, int port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+// 读一个完整响应（头部 + Content-Length 个字节），返回 body 长度，出错返回 -1
+long ReadResponse(int fd, std::string *buffer)
+{
+    size_t header_end;
+    while ((header_end = buffer->find("\r\n\r\n")) == std::string::npos) {
+        char chunk[16384];
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0) return -1;
+        buffer->append(chunk, n);
+    }
+    std::string headers = buffer->substr(0, header_end);
+    for (auto &c : headers) c = tolower(c);
+    size_t pos = headers.find("content-length:");
+    long length = pos == std::string::npos ? 0 : atol(headers.c_str() + pos + 15);
+    size_t total = header_end + 4 + length;
+    while (buffer->size() < total) {
+        char chunk[65536];
+        ssize_t n = read(fd, chunk, std::min(sizeof(chunk), total - buffer->size()));
+        if (n <= 0) return -1;
+        buffer->append(chunk, n);
+    }
+    buffer->erase(0, total);
+    return length;
+}
+
+void Run(const std::string &host, int port, const std::string &path, int connections, int duration_ms)
+{
+    std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: keep-alive\r\n\r\n";
+    std::atomic<bool> start(false), stop(false);
+    std::atomic<uint64_t> requests(0), bytes(0), errors(0);
+    std::vector<std::thread> clients;
+    for (int c = 0; c < connections; c++) {
+        clients.emplace_back([&]() {
+            int fd = Connect(host, port);
+            std::string buffer;
+            uint64_t local_requests = 0, local_bytes = 0;
+            while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+            while (fd != -1 && !stop.load(std::memory_order_relaxed)) {
+                long length = -1;
+                if (write(fd, request.data(), request.size()) == (ssize_t)request.size()) {
+                    length = ReadResponse(fd, &buffer);
+                }
+                if (length < 0) {
+                    // 服务端关闭了连接就重连
+                    errors++;
+                    close(fd);
+                    buffer.clear();
+                    fd = Connect(host, port);
+                    continue;
+                }
+                ++local_requests;
+                local_bytes += length;
+            }
+            if (fd != -1) close(fd);
+            requests += local_requests;
+            bytes += local_bytes;
+        });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+    stop.store(true);
+    for (auto &client : clients) client.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    printf("{\"bench\":\"http_throughput\",\"path\":\"%s\",\"connections\":%d,\"requests\":%llu,\"errors\":%llu,"
+           "\"rps\":%.1f,\"mb_per_s\":%.2f}\n",
+           path.c_str(), connections, (unsigned long long)requests.load(), (unsigned long long)errors.load(),
+           requests / seconds, bytes / seconds / (1024 * 1024));
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 4) {
+        fprintf(stderr, "usage: %s <host> <port> <path> [connections,...] [duration_ms]\n", argv[0]);
+        return 1;
+    }
+    std::string host = argv[1];
+    int port = atoi(argv[2]);
+    std::string path = argv[3];
+    std::string connection_list = argc > 4 ? argv[4] : "1,4,16,64";
+    int duration_ms = argc > 5 ? atoi(argv[5]) : 3000;
+
+    std::stringstream ss(connection_list);
+    std::string item;
+    while (std::getline(ss, item, ',')) Run(host, port, path, atoi(item.c_str()), duration_ms);
+    return 0;
+}
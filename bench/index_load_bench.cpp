@@ -0,0 +1,85 @@
+// 冷启动基准：同样的条目数下比较 JSON 快照与二进制索引的 DataManager 加载耗时
+// 用法: index_load_bench [entries]，每个测量输出一行 JSON
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#include "../data_manager.hpp"
+#include "../../LogSystem/utils.hpp"
+#include "../../LogSystem/manage.hpp"
+
+void log_system_module_init()
+{
+    std::shared_ptr<wwlog::LoggerBuilder> logger_builder(new wwlog::LoggerBuilder());
+    logger_builder->SetLoggerName("asynclogger");
+    logger_builder->AddLoggerFlush<wwlog::FileFlush>("./bench.log");
+    logger_builder->SetThreadPool(std::shared_ptr<ThreadPool>(new ThreadPool(1)));
+    wwlog::LoggerManager::GetInstance().AddLogger(logger_builder->Build());
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    size_t entries = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+
+    char dir[] = "/tmp/filerelay-bench-XXXXXX";
+    if (mkdtemp(dir) == nullptr || chdir(dir) == -1) {
+        perror("mkdtemp");
+        return 1;
+    }
+    std::string conf = "{\"download_prefix\":\"/download/\",\"storage_info\":\"./storage.data\","
+                       "\"storage_journal\":\"./storage.journal\",\"journal_checkpoint\":0}";
+    wwstorage::File(wwstorage::ConfigFile).SetContent(conf.c_str(), conf.size());
+    log_system_module_init();
+
+    std::vector<wwstorage::StorageInfo> arr(entries);
+    for (size_t i = 0; i < entries; i++) {
+        arr[i].mtime_ = 1700000000 + i;
+        arr[i].atime_ = arr[i].mtime_;
+        arr[i].fsize_ = i * 4096;
+        arr[i].url_ = "/download/file-" + std::to_string(i) + ".bin";
+        arr[i].storage_path_ = "./low_storage/file-" + std::to_string(i) + ".bin";
+    }
+
+    // JSON 快照
+    Json::Value root(Json::arrayValue);
+    for (auto &e : arr) {
+        Json::Value item;
+        wwstorage::DataManager::ToJson(e, &item);
+        root.append(item);
+    }
+    std::string body;
+    wwstorage::JsonConveter::ToString(root, &body);
+    root.clear();
+    wwstorage::File("./storage.data").SetContent(body.c_str(), body.size());
+    auto start = std::chrono::steady_clock::now();
+    delete new wwstorage::DataManager();
+    printf("{\"bench\":\"index_load\",\"format\":\"json\",\"entries\":%zu,\"bytes\":%zu,\"ms\":%.2f}\n", entries,
+           body.size(), ElapsedMs(start));
+
+    // 二进制索引
+    wwstorage::IndexWriter writer;
+    writer.Reserve(entries);
+    for (auto &e : arr) writer.Add(e.mtime_, e.atime_, e.fsize_, e.url_, e.storage_path_);
+    writer.Write("./storage.data");
+    size_t bytes = wwstorage::File("./storage.data").Size();
+    start = std::chrono::steady_clock::now();
+    {
+        wwstorage::IndexMap index;
+        index.Open("./storage.data");
+    }
+    printf("{\"bench\":\"index_map_validate\",\"format\":\"binary\",\"entries\":%zu,\"bytes\":%zu,\"ms\":%.2f}\n",
+           entries, bytes, ElapsedMs(start));
+    start = std::chrono::steady_clock::now();
+    delete new wwstorage::DataManager();
+    printf("{\"bench\":\"index_load\",\"format\":\"binary\",\"entries\":%zu,\"bytes\":%zu,\"ms\":%.2f}\n", entries,
+           bytes, ElapsedMs(start));
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,203 @@
+// 微基准：DataManager 的 Insert/GetOneByURL/Storage/InitLoad，File 的 SetContent/GetPosLen，
+// UrlDecode 和 base64_decode。表大小从 1k 按 10 倍增长到 max_entries，文件大小从 4KB 按 4 倍增长到 max_file_mb（默认 1GB）。
+// 每个测量输出一行 JSON，键是 bench + size，ns_per_op 取多轮里的中位数，可以用 bench_compare 对比两个版本的输出。
+// 用法: micro_bench [max_entries] [max_file_mb] [filter]，filter 非空时只跑名字里包含它的测量
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+
+#include "../data_manager.hpp"
+#include "../lib/base64.h"
+#include "../../LogSystem/utils.hpp"
+#include "../../LogSystem/manage.hpp"
+
+void log_system_module_init()
+{
+    std::shared_ptr<wwlog::LoggerBuilder> logger_builder(new wwlog::LoggerBuilder());
+    logger_builder->SetLoggerName("asynclogger");
+    logger_builder->AddLoggerFlush<wwlog::FileFlush>("./bench.log");
+    logger_builder->SetThreadPool(std::shared_ptr<ThreadPool>(new ThreadPool(1)));
+    wwlog::LoggerManager::GetInstance().AddLogger(logger_builder->Build());
+}
+
+const int kRounds = 5;
+const double kMinRoundSec = 0.1;
+std::string filter;
+
+double ElapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Report(const char *bench, uint64_t size, uint64_t iterations, std::vector<double> ns_per_op, uint64_t bytes)
+{
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+    double median = ns_per_op[ns_per_op.size() / 2];
+    printf("{\"bench\":\"%s\",\"size\":%llu,\"iterations\":%llu,\"ns_per_op\":%.1f,\"min_ns_per_op\":%.1f", bench,
+           (unsigned long long)size, (unsigned long long)iterations, median, ns_per_op.front());
+    if (bytes > 0) printf(",\"mb_per_s\":%.2f", bytes / median * 1e9 / 1048576);
+    printf("}\n");
+    fflush(stdout);
+}
+
+// 每轮把 op 重复到至少 kMinRoundSec，跑 kRounds 轮；bytes 是每次 op 处理的字节数，用来算吞吐
+void Measure(const char *bench, uint64_t size, uint64_t bytes, const std::function<void()> &op)
+{
+    if (!filter.empty() && strstr(bench, filter.c_str()) == nullptr) return;
+    op();  // 预热
+    uint64_t batch = 1;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < batch; i++) op();
+        if (ElapsedNs(start) >= kMinRoundSec * 1e9 || batch >= (1ULL << 30)) break;
+        batch *= 2;
+    }
+    std::vector<double> rounds;
+    for (int r = 0; r < kRounds; r++) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < batch; i++) op();
+        rounds.push_back(ElapsedNs(start) / batch);
+    }
+    Report(bench, size, batch * kRounds, rounds, bytes);
+}
+
+// 只能跑一次的测量（建表、加载），重复 kRounds 轮，每轮之前调用 setup
+void MeasureOnce(const char *bench, uint64_t size, uint64_t ops, const std::function<void()> &setup,
+                 const std::function<void()> &op)
+{
+    if (!filter.empty() && strstr(bench, filter.c_str()) == nullptr) return;
+    std::vector<double> rounds;
+    for (int r = 0; r < kRounds; r++) {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        op();
+        rounds.push_back(ElapsedNs(start) / ops);
+    }
+    Report(bench, size, ops * kRounds, rounds, 0);
+}
+
+wwstorage::StorageInfo InfoOf(size_t i)
+{
+    wwstorage::StorageInfo info;
+    info.mtime_ = 1700000000 + i;
+    info.atime_ = info.mtime_;
+    info.fsize_ = i * 4096;
+    info.url_ = "/download/file-" + std::to_string(i) + ".bin";
+    info.storage_path_ = "./low_storage/file-" + std::to_string(i) + ".bin";
+    return info;
+}
+
+void ResetIndex()
+{
+    remove("./storage.data");
+    remove("./storage.journal");
+}
+
+void BenchDataManager(size_t entries)
+{
+    std::vector<wwstorage::StorageInfo> infos;
+    infos.reserve(entries);
+    for (size_t i = 0; i < entries; i++) infos.push_back(InfoOf(i));
+
+    wwstorage::DataManager *data = nullptr;
+    auto fresh = [&data]() {
+        delete data;
+        ResetIndex();
+        data = new wwstorage::DataManager();
+    };
+    // 从空表插入 entries 条，ns_per_op 是平均每条
+    MeasureOnce("datamanager_insert", entries, entries, fresh, [&]() {
+        for (auto &info : infos) data->Insert(info);
+    });
+    if (data == nullptr) {
+        fresh();
+        for (auto &info : infos) data->Insert(info);
+    }
+
+    std::mt19937_64 rng(42);
+    std::vector<std::string> urls;
+    for (int i = 0; i < 4096; i++) urls.push_back(infos[rng() % entries].url_);
+    size_t next = 0;
+    wwstorage::StorageInfo found;
+    Measure("datamanager_get_by_url", entries, 0, [&]() { data->GetOneByURL(urls[next++ % urls.size()], &found); });
+    Measure("datamanager_get_by_url_miss", entries, 0, [&]() { data->GetOneByURL("/download/missing.bin", &found); });
+    MeasureOnce("datamanager_storage", entries, 1, []() {}, [&]() { data->Storage(); });
+
+    // 加载只有快照、没有日志的索引
+    data->Storage();
+    delete data;
+    data = nullptr;
+    remove("./storage.journal");
+    MeasureOnce("datamanager_init_load", entries, 1, [&data]() {
+        delete data;
+        data = nullptr;
+    }, [&data]() { data = new wwstorage::DataManager(); });
+    delete data;
+    ResetIndex();
+}
+
+void BenchFile(uint64_t size)
+{
+    std::string content(size, 0);
+    std::mt19937_64 rng(size);
+    for (size_t i = 0; i + 8 <= size; i += 8) {
+        uint64_t v = rng();
+        memcpy(&content[i], &v, 8);
+    }
+    wwstorage::File file("./file.bin");
+    Measure("file_set_content", size, size, [&]() { file.SetContent(content.data(), content.size()); });
+    std::string out;
+    Measure("file_get_pos_len", size, size, [&]() { file.GetPosLen(&out, 0, size); });
+    Measure("file_get_pos_len_4k", size, 4096, [&]() { file.GetPosLen(&out, rng() % (size - 4096 + 1), 4096); });
+    remove("./file.bin");
+}
+
+void BenchStrings()
+{
+    std::string ascii = "/download/report-2024-final.tar.gz";
+    std::string escaped = "/download/%E5%AD%A3%E5%BA%A6%E6%8A%A5%E5%91%8A%202024%20final%20"
+                          "(%E5%89%AF%E6%9C%AC).tar.gz";
+    std::string name = base64_encode(std::string("季度报告 2024 final (副本).tar.gz"));
+    std::string big(4096, 0);
+    for (size_t i = 0; i < big.size(); i++) big[i] = (char)(i * 131);
+    std::string big64 = base64_encode(big);
+    volatile size_t sink = 0;
+    Measure("url_decode_ascii", ascii.size(), ascii.size(), [&]() { sink += wwstorage::UrlDecode(ascii).size(); });
+    Measure("url_decode_escaped", escaped.size(), escaped.size(),
+            [&]() { sink += wwstorage::UrlDecode(escaped).size(); });
+    Measure("base64_decode_name", name.size(), name.size(), [&]() { sink += base64_decode(name).size(); });
+    Measure("base64_decode_4k", big64.size(), big64.size(), [&]() { sink += base64_decode(big64).size(); });
+}
+
+int main(int argc, char *argv[])
+{
+    size_t max_entries = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    uint64_t max_file = (argc > 2 ? strtoull(argv[2], nullptr, 10) : 1024) * 1024 * 1024;
+    filter = argc > 3 ? argv[3] : "";
+
+    char dir[] = "/tmp/filerelay-bench-XXXXXX";
+    if (mkdtemp(dir) == nullptr || chdir(dir) == -1) {
+        perror("mkdtemp");
+        return 1;
+    }
+    // 日志不 fsync，测的是索引本身的开销
+    std::string conf = "{\"download_prefix\":\"/download/\",\"storage_info\":\"./storage.data\","
+                       "\"storage_journal\":\"./storage.journal\",\"journal_checkpoint\":0,"
+                       "\"storage_format\":\"binary\",\"durability\":\"none\"}";
+    wwstorage::File(wwstorage::ConfigFile).SetContent(conf.c_str(), conf.size());
+    log_system_module_init();
+
+    BenchStrings();
+    for (size_t entries = 1000; entries <= max_entries; entries *= 10) BenchDataManager(entries);
+    uint64_t size = 4096;
+    for (; size <= max_file; size *= 4) BenchFile(size);
+    // max_file_mb 不是 4KB 乘 4 的幂时补测一次最大值
+    if (max_file >= 4096 && size / 4 != max_file) BenchFile(max_file);
+
+    std::filesystem::remove_all(dir);
+    return 0;
+}
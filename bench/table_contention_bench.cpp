@@ -0,0 +1,93 @@
+// 锁竞争基准：单把读写锁（table_shards = 1，即分片前的 DataManager）与分片表对比，
+// 1~64 个线程混合执行 GetByUrl/Put，每个组合输出一行 JSON
+// 用法: table_contention_bench [entries] [duration_ms] [write_percent] [shards]
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "../storage_table.hpp"
+#include "../../LogSystem/utils.hpp"
+#include "../../LogSystem/manage.hpp"
+
+void log_system_module_init()
+{
+    std::shared_ptr<wwlog::LoggerBuilder> logger_builder(new wwlog::LoggerBuilder());
+    logger_builder->SetLoggerName("asynclogger");
+    logger_builder->AddLoggerFlush<wwlog::StdoutFlush>();
+    logger_builder->SetThreadPool(std::shared_ptr<ThreadPool>(new ThreadPool(1)));
+    wwlog::LoggerManager::GetInstance().AddLogger(logger_builder->Build());
+}
+
+std::string UrlOf(size_t i) { return "/download/file-" + std::to_string(i) + ".bin"; }
+
+wwstorage::StorageInfo InfoOf(size_t i, time_t mtime)
+{
+    wwstorage::StorageInfo info;
+    info.mtime_ = mtime;
+    info.atime_ = mtime;
+    info.fsize_ = i;
+    info.url_ = UrlOf(i);
+    info.storage_path_ = "./low_storage/file-" + std::to_string(i) + ".bin";
+    return info;
+}
+
+double Run(size_t shards, int threads, size_t entries, int duration_ms, int write_percent, uint64_t *total_ops)
+{
+    wwstorage::StorageTable table(shards);
+    table.Reserve(entries);
+    for (size_t i = 0; i < entries; i++) table.Put(InfoOf(i, 1700000000));
+
+    std::vector<std::string> urls(entries);
+    for (size_t i = 0; i < entries; i++) urls[i] = UrlOf(i);
+
+    std::atomic<bool> start(false), stop(false);
+    std::atomic<uint64_t> ops(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            uint64_t seed = 0x9E3779B97F4A7C15ULL * (t + 1), local = 0;
+            wwstorage::StorageInfo info;
+            while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed)) {
+                seed ^= seed << 13, seed ^= seed >> 7, seed ^= seed << 17;
+                size_t key = seed % entries;
+                if ((int)(seed >> 32) % 100 < write_percent) {
+                    table.Put(InfoOf(key, 1700000000 + local));
+                } else {
+                    table.GetByUrl(urls[key], &info);
+                }
+                ++local;
+            }
+            ops.fetch_add(local);
+        });
+    }
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::milliseconds(duration_ms));
+    stop.store(true);
+    for (auto &w : workers) w.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    *total_ops = ops.load();
+    return ops.load() / secs;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t entries = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+    int duration_ms = argc > 2 ? atoi(argv[2]) : 500;
+    int write_percent = argc > 3 ? atoi(argv[3]) : 5;
+    size_t sharded = argc > 4 ? strtoull(argv[4], nullptr, 10) : 16;
+    log_system_module_init();
+
+    for (size_t shards : {(size_t)1, sharded}) {
+        for (int threads = 1; threads <= 64; threads *= 2) {
+            uint64_t ops = 0;
+            double rate = Run(shards, threads, entries, duration_ms, write_percent, &ops);
+            printf("{\"bench\":\"table_contention\",\"shards\":%zu,\"threads\":%d,\"entries\":%zu,"
+                   "\"write_percent\":%d,\"ops\":%llu,\"ops_per_sec\":%.0f}\n",
+                   shards, threads, entries, write_percent, (unsigned long long)ops, rate);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
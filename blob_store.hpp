@@ -0,0 +1,144 @@
+#pragma once
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "utils.hpp"
+
+namespace wwstorage {
+
+// 内容寻址的 blob 仓库：相同内容只存一份，blob_dir/<前两位>/<sha256>.<low|deep>。
+// low_storage/deep_storage 下的文件是指向 blob 的硬链接，原有的路径、下载、ETag 逻辑都不用变；
+// 引用计数就是 inode 的链接数减一，不需要单独持久化，崩溃后也不会和实际情况不一致。
+// 链接数降到 1（只剩 blob 自己）的 blob 没有人用了，被覆盖时或启动时回收
+class BlobStore {
+public:
+    BlobStore(const std::string &blob_dir) : blob_dir_(blob_dir), seq_(0), dedup_hits_(0), bytes_saved_(0) {}
+
+    // 扫描已有 blob 建立 inode 索引，顺便回收没有引用的 blob 和上次残留的临时文件
+    bool Init()
+    {
+        if (!File(blob_dir_).CreateDirectory()) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t collected = 0;
+        for (auto &entry : std::filesystem::recursive_directory_iterator(blob_dir_)) {
+            if (!entry.is_regular_file()) continue;
+            std::string path = entry.path().string();
+            struct stat st;
+            if (stat(path.c_str(), &st) == -1) continue;
+            if (entry.path().filename().string().compare(0, 5, ".tmp-") == 0 || st.st_nlink <= 1) {
+                remove(path.c_str());
+                collected++;
+                continue;
+            }
+            inodes_[st.st_ino] = path;
+        }
+        wwlog::GetLogger("asynclogger")->Info("blob store loaded: %u blobs, collected: %u", inodes_.size(), collected);
+        return true;
+    }
+    // 新内容先写到这个临时路径，再用 AdoptAndLink 收进仓库
+    std::string TempPath()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return blob_dir_ + ".tmp-" + std::to_string(getpid()) + "-" + std::to_string(seq_++);
+    }
+    // 把 src 收为 (hash, kind) 的 blob 并让 storage_path 指向它，src 总会被删掉。
+    // 并发上传了同样内容时保留先到的一份；两步在同一把锁里做，中间不会被别的覆盖回收掉
+    bool AdoptAndLink(const std::string &src, const std::string &hash, const std::string &kind,
+                      const std::string &storage_path)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return Adopt(src, hash, kind) && Link(BlobPath(hash, kind), storage_path);
+    }
+    // 让 storage_path 指向已有的 blob，blob 不存在返回 false
+    bool Link(const std::string &hash, const std::string &kind, const std::string &storage_path)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return Link(BlobPath(hash, kind), storage_path);
+    }
+    // storage_path 即将被别的内容覆盖或删除时调用，必要时回收它指向的 blob
+    void Unlink(const std::string &storage_path)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        struct stat st;
+        if (stat(storage_path.c_str(), &st) == -1) return;
+        remove(storage_path.c_str());
+        Release(st.st_ino);
+    }
+    void CountHit(uint64_t bytes)
+    {
+        dedup_hits_++;
+        bytes_saved_ += bytes;
+    }
+
+    std::string BlobPath(const std::string &hash, const std::string &kind)
+    {
+        return blob_dir_ + hash.substr(0, 2) + "/" + hash + "." + kind;
+    }
+    size_t Blobs()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return inodes_.size();
+    }
+    uint64_t DedupHits() const { return dedup_hits_; }
+    uint64_t BytesSaved() const { return bytes_saved_; }
+
+private:
+    // 以下调用方持有 mutex_
+    bool Adopt(const std::string &src, const std::string &hash, const std::string &kind)
+    {
+        std::string blob = BlobPath(hash, kind);
+        File(blob.substr(0, blob.find_last_of('/') + 1)).CreateDirectory();
+        if (link(src.c_str(), blob.c_str()) == -1 && errno != EEXIST) {
+            wwlog::GetLogger("asynclogger")->Error("blob adopt %s error: %s", blob.c_str(), strerror(errno));
+            remove(src.c_str());
+            return false;
+        }
+        remove(src.c_str());
+        struct stat st;
+        if (stat(blob.c_str(), &st) == 0) inodes_[st.st_ino] = blob;
+        return true;
+    }
+    // 先链接到临时名再 rename 覆盖，被覆盖的旧文件如果是 blob 的最后一个引用，blob 一并回收
+    bool Link(const std::string &blob, const std::string &storage_path)
+    {
+        struct stat blob_st, old_st;
+        if (stat(blob.c_str(), &blob_st) == -1) return false;
+        bool replaced = stat(storage_path.c_str(), &old_st) == 0;
+        // 同名文件已经指向这个 blob，rename 到同一个 inode 是空操作
+        if (replaced && old_st.st_ino == blob_st.st_ino && old_st.st_dev == blob_st.st_dev) return true;
+
+        std::string tmp = storage_path + ".link-" + std::to_string(seq_++);
+        if (link(blob.c_str(), tmp.c_str()) == -1 || rename(tmp.c_str(), storage_path.c_str()) == -1) {
+            wwlog::GetLogger("asynclogger")->Error("blob link %s error: %s", storage_path.c_str(), strerror(errno));
+            remove(tmp.c_str());
+            return false;
+        }
+        if (replaced) Release(old_st.st_ino);
+        return true;
+    }
+    void Release(ino_t ino)
+    {
+        auto it = inodes_.find(ino);
+        if (it == inodes_.end()) return;
+        struct stat st;
+        if (stat(it->second.c_str(), &st) == 0 && st.st_nlink > 1) return;
+        wwlog::GetLogger("asynclogger")->Info("blob collected: %s", it->second.c_str());
+        remove(it->second.c_str());
+        inodes_.erase(it);
+    }
+
+private:
+    std::string blob_dir_;
+    std::mutex mutex_;  // 保护 inodes_、seq_，并串行化链接操作，避免和回收交错
+    std::unordered_map<ino_t, std::string> inodes_;
+    uint64_t seq_;
+    std::atomic<uint64_t> dedup_hits_;
+    std::atomic<uint64_t> bytes_saved_;
+};
+
+}  // namespace wwstorage
@@ -0,0 +1,381 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "content_encoding.hpp"
+#include "utils.hpp"
+
+namespace wwstorage {
+
+// deep_storage 分块容器格式：
+//   BlockHeader | 块 0 | 块 1 | ... | BlockIndexEntry * block_count | BlockFooter
+// 每块是对 block_size 字节原始数据独立压缩的结果，封装方式由头部的 encoding 决定（见 ContentEncoding）。
+// 块索引和尾部放在文件末尾，写入时只需要顺序追加，读取时从尾部定位任意块；
+// 所有块连续存放，encoding 为 gzip/zstd 时头部和索引之间的字节就是一个完整的编码流
+const char kBlockMagic[4] = {'F', 'R', 'B', 'K'};
+const uint32_t kBlockVersion = 1;
+
+struct BlockHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t block_size;
+    uint64_t encoding;  // ContentEncoding，旧文件这里是 0，即 bundle
+    uint64_t reserved;
+};
+
+struct BlockIndexEntry {
+    uint64_t offset;
+    uint64_t packed_len;
+    uint64_t raw_len;
+};
+
+struct BlockFooter {
+    uint64_t index_offset;
+    uint64_t block_count;
+    uint64_t raw_size;
+    char magic[4];
+    uint32_t version;
+};
+
+static_assert(sizeof(BlockHeader) == 32, "BlockHeader layout changed");
+static_assert(sizeof(BlockFooter) == 32, "BlockFooter layout changed");
+
+static bool WriteAll(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t ret = write(fd, data, len);
+        if (ret == -1) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += ret;
+        len -= ret;
+    }
+    return true;
+}
+
+static bool ReadAt(int fd, char *data, size_t len, uint64_t offset)
+{
+    while (len > 0) {
+        ssize_t ret = pread(fd, data, len, offset);
+        if (ret == -1 && errno == EINTR) continue;
+        if (ret <= 0) return false;
+        data += ret;
+        len -= ret;
+        offset += ret;
+    }
+    return true;
+}
+
+// 用 threads 个线程（含调用线程）处理 [0, count) 的下标，块之间互不依赖
+static void ParallelFor(size_t count, int threads, const std::function<void(size_t)> &fn)
+{
+    std::atomic<size_t> next(0);
+    auto run = [&]() {
+        for (size_t i; (i = next++) < count;) fn(i);
+    };
+    std::vector<std::thread> helpers;
+    for (int t = 1; t < threads && (size_t)t < count; t++) helpers.emplace_back(run);
+    run();
+    for (auto &helper : helpers) helper.join();
+}
+
+// 边写边压缩：攒够 threads 个块后并行压缩，再按顺序写出，内存占用是 threads 个块
+class BlockWriter {
+public:
+    BlockWriter(const std::string &file_name, int format, size_t block_size, int threads = 1,
+                ContentEncoding encoding = kEncodingBundle)
+        : file_name_(file_name), format_(format), block_size_(block_size > 0 ? block_size : 1),
+          threads_(threads > 0 ? threads : 1), encoding_(encoding), fd_(-1), offset_(0), raw_size_(0)
+    {
+    }
+    ~BlockWriter()
+    {
+        if (fd_ != -1) close(fd_);
+    }
+
+    bool Open()
+    {
+        fd_ = open(file_name_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ == -1) {
+            wwlog::GetLogger("asynclogger")->Info("%s, block file open error: %s", file_name_.c_str(), strerror(errno));
+            return false;
+        }
+        BlockHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kBlockMagic, sizeof(header.magic));
+        header.version = kBlockVersion;
+        header.block_size = block_size_;
+        header.encoding = encoding_;
+        if (!WriteAll(fd_, (const char *)&header, sizeof(header))) return WriteError();
+        offset_ = sizeof(header);
+        return true;
+    }
+    bool Write(const char *data, size_t len)
+    {
+        while (len > 0) {
+            if (batch_.empty() || batch_.back().size() == block_size_) {
+                if (batch_.size() == (size_t)threads_ && !FlushBatch()) return false;
+                batch_.emplace_back();
+                batch_.back().reserve(block_size_);
+            }
+            std::string &pending = batch_.back();
+            size_t n = std::min(len, block_size_ - pending.size());
+            pending.append(data, n);
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+    bool Finish()
+    {
+        if (!FlushBatch()) return false;
+        BlockFooter footer;
+        memset(&footer, 0, sizeof(footer));
+        footer.index_offset = offset_;
+        footer.block_count = index_.size();
+        footer.raw_size = raw_size_;
+        memcpy(footer.magic, kBlockMagic, sizeof(footer.magic));
+        footer.version = kBlockVersion;
+        if (!WriteAll(fd_, (const char *)index_.data(), index_.size() * sizeof(BlockIndexEntry)) ||
+            !WriteAll(fd_, (const char *)&footer, sizeof(footer))) {
+            return WriteError();
+        }
+        close(fd_);
+        fd_ = -1;
+        return true;
+    }
+    // 把 src 文件按块压缩成容器，不需要把整个文件读进内存
+    static bool CompressFile(const std::string &src, const std::string &dst, int format, size_t block_size,
+                             int threads = 1, ContentEncoding encoding = kEncodingBundle)
+    {
+        std::ifstream ifs(src, std::ios::binary);
+        if (ifs.is_open() == false) {
+            wwlog::GetLogger("asynclogger")->Info("%s, file open error.", src.c_str());
+            return false;
+        }
+        BlockWriter writer(dst, format, block_size, threads, encoding);
+        if (!writer.Open()) return false;
+        std::string buffer(writer.block_size_, 0);
+        while (ifs) {
+            ifs.read(&buffer[0], buffer.size());
+            if (ifs.gcount() > 0 && !writer.Write(buffer.data(), ifs.gcount())) return false;
+        }
+        if (ifs.bad()) {
+            wwlog::GetLogger("asynclogger")->Info("%s, read file content error.", src.c_str());
+            return false;
+        }
+        return writer.Finish();
+    }
+
+private:
+    // 并行压缩攒下的块，按块顺序写入文件
+    bool FlushBatch()
+    {
+        std::vector<std::string> packed(batch_.size());
+        ParallelFor(batch_.size(), threads_, [&](size_t i) {
+            if (!EncodeFrame(encoding_, format_, batch_[i], &packed[i])) packed[i].clear();
+        });
+        for (size_t i = 0; i < batch_.size(); i++) {
+            if (packed[i].empty()) {
+                wwlog::GetLogger("asynclogger")->Info("compress package size checked error.");
+                return false;
+            }
+            if (!WriteAll(fd_, packed[i].data(), packed[i].size())) return WriteError();
+            index_.push_back({offset_, packed[i].size(), batch_[i].size()});
+            offset_ += packed[i].size();
+            raw_size_ += batch_[i].size();
+        }
+        batch_.clear();
+        return true;
+    }
+    bool WriteError()
+    {
+        wwlog::GetLogger("asynclogger")->Info("%s, block file write error: %s", file_name_.c_str(), strerror(errno));
+        return false;
+    }
+
+private:
+    std::string file_name_;
+    int format_;
+    size_t block_size_;
+    int threads_;
+    ContentEncoding encoding_;
+    int fd_;
+    uint64_t offset_;
+    uint64_t raw_size_;
+    std::vector<std::string> batch_;  // 最后一个可能是未满的块
+    std::vector<BlockIndexEntry> index_;
+};
+
+// 通过尾部的块索引随机访问，读任意区间只解压覆盖到的块，多个块时并行解压
+class BlockReader {
+public:
+    BlockReader()
+        : fd_(-1), threads_(1), block_size_(0), raw_size_(0), encoding_(kEncodingBundle), index_offset_(0)
+    {
+    }
+    ~BlockReader()
+    {
+        if (fd_ != -1) close(fd_);
+    }
+    BlockReader(const BlockReader &) = delete;
+    BlockReader &operator=(const BlockReader &) = delete;
+
+    static bool IsBlockFile(const std::string &file_name)
+    {
+        char magic[sizeof(kBlockMagic)] = {0};
+        std::ifstream ifs(file_name, std::ios::binary);
+        ifs.read(magic, sizeof(magic));
+        return ifs.good() && memcmp(magic, kBlockMagic, sizeof(magic)) == 0;
+    }
+    bool Open(const std::string &file_name)
+    {
+        file_name_ = file_name;
+        fd_ = open(file_name.c_str(), O_RDONLY);
+        if (fd_ == -1) {
+            wwlog::GetLogger("asynclogger")->Info("%s, block file open error: %s", file_name.c_str(), strerror(errno));
+            return false;
+        }
+        int64_t size = File(file_name).Size();
+        BlockHeader header;
+        BlockFooter footer;
+        if (size < (int64_t)(sizeof(header) + sizeof(footer)) || !ReadAt(fd_, (char *)&header, sizeof(header), 0) ||
+            !ReadAt(fd_, (char *)&footer, sizeof(footer), size - sizeof(footer))) {
+            return FormatError();
+        }
+        if (memcmp(header.magic, kBlockMagic, 4) != 0 || memcmp(footer.magic, kBlockMagic, 4) != 0 ||
+            header.version != kBlockVersion || footer.version != kBlockVersion ||
+            (header.block_size == 0 && footer.block_count > 0) || header.encoding > kEncodingZstd) {
+            return FormatError();
+        }
+        // 都用减法比较，损坏的文件里加法可能溢出回绕
+        uint64_t body_end = (uint64_t)size - sizeof(footer);
+        uint64_t index_len = footer.block_count * sizeof(BlockIndexEntry);
+        if (footer.block_count > body_end / sizeof(BlockIndexEntry) || footer.index_offset != body_end - index_len ||
+            footer.index_offset < sizeof(header) || (header.block_size == 0 && footer.raw_size > 0)) {
+            return FormatError();
+        }
+        index_.resize(footer.block_count);
+        if (index_len > 0 && !ReadAt(fd_, (char *)index_.data(), index_len, footer.index_offset)) return FormatError();
+        // 块紧挨着存放在头部和索引之间；除最后一块外原始长度都是 block_size，合计等于 raw_size
+        uint64_t offset = sizeof(header), raw_size = 0;
+        for (size_t i = 0; i < index_.size(); i++) {
+            const BlockIndexEntry &entry = index_[i];
+            bool last = i + 1 == index_.size();
+            if (entry.offset != offset || entry.packed_len > footer.index_offset - offset ||
+                (last ? entry.raw_len == 0 || entry.raw_len > header.block_size : entry.raw_len != header.block_size) ||
+                entry.raw_len > footer.raw_size - raw_size) {
+                return FormatError();
+            }
+            offset += entry.packed_len;
+            raw_size += entry.raw_len;
+        }
+        if (offset != footer.index_offset || raw_size != footer.raw_size) return FormatError();
+        block_size_ = header.block_size;
+        raw_size_ = footer.raw_size;
+        encoding_ = (ContentEncoding)header.encoding;
+        index_offset_ = footer.index_offset;
+        return true;
+    }
+    void SetThreads(int threads) { threads_ = threads > 0 ? threads : 1; }
+    uint64_t RawSize() const { return raw_size_; }
+    uint64_t BlockSize() const { return block_size_; }
+    size_t BlockCount() const { return index_.size(); }
+    const BlockIndexEntry &Block(size_t i) const { return index_[i]; }
+    ContentEncoding Encoding() const { return encoding_; }
+    // 所有块在文件里占的区间，encoding 不是 bundle 时可以原样作为编码后的响应体
+    uint64_t BodyOffset() const { return sizeof(BlockHeader); }
+    uint64_t BodyLength() const { return index_offset_ - sizeof(BlockHeader); }
+
+    bool ReadBlock(size_t i, std::string *content)
+    {
+        const BlockIndexEntry &entry = index_[i];
+        std::string packed(entry.packed_len, 0);
+        if (!ReadAt(fd_, &packed[0], packed.size(), entry.offset)) return FormatError();
+        if (!DecodeFrame(encoding_, packed, entry.raw_len, content)) return FormatError();
+        return true;
+    }
+    bool ReadRange(uint64_t pos, uint64_t len, std::string *content)
+    {
+        content->clear();
+        if (pos + len > raw_size_) {
+            wwlog::GetLogger("asynclogger")->Info("needed data larger than file size.");
+            return false;
+        }
+        content->reserve(len);
+        std::vector<std::string> blocks;
+        size_t i = pos / block_size_;
+        while (len > 0 && i < index_.size()) {
+            size_t count = std::min<size_t>(threads_, index_.size() - i);
+            count = std::min<size_t>(count, (pos + len - 1) / block_size_ - i + 1);
+            if (!ReadBlocks(i, count, &blocks)) return false;
+            for (auto &block : blocks) {
+                uint64_t skip = pos - i * block_size_;
+                uint64_t n = std::min<uint64_t>(len, block.size() - skip);
+                content->append(block, skip, n);
+                pos += n;
+                len -= n;
+                i++;
+            }
+        }
+        return len == 0;
+    }
+    // 并行解压 [first, first + count) 这些块
+    bool ReadBlocks(size_t first, size_t count, std::vector<std::string> *blocks)
+    {
+        blocks->resize(count);
+        std::atomic<bool> ok(true);
+        ParallelFor(count, threads_, [&](size_t i) {
+            if (!ReadBlock(first + i, &(*blocks)[i])) ok = false;
+        });
+        return ok;
+    }
+    // 每次并行解压 threads 个块后按顺序写入 dst，内存占用是 threads 个块
+    bool DecodeTo(const std::string &dst)
+    {
+        std::ofstream ofs(dst, std::ios::binary | std::ios::trunc);
+        if (ofs.is_open() == false) {
+            wwlog::GetLogger("asynclogger")->Info("%s, file open error.", dst.c_str());
+            return false;
+        }
+        std::vector<std::string> blocks;
+        for (size_t i = 0; i < index_.size(); i += blocks.size()) {
+            if (!ReadBlocks(i, std::min<size_t>(threads_, index_.size() - i), &blocks)) return false;
+            for (auto &block : blocks) ofs.write(block.data(), block.size());
+        }
+        ofs.close();
+        if (!ofs.good()) {
+            wwlog::GetLogger("asynclogger")->Info("%s, write file content error.", dst.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool FormatError()
+    {
+        wwlog::GetLogger("asynclogger")->Info("%s, block file corrupted.", file_name_.c_str());
+        return false;
+    }
+
+private:
+    std::string file_name_;
+    int fd_;
+    int threads_;
+    uint64_t block_size_;
+    uint64_t raw_size_;
+    ContentEncoding encoding_;
+    uint64_t index_offset_;
+    std::vector<BlockIndexEntry> index_;
+};
+
+}  // namespace wwstorage
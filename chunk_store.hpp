@@ -0,0 +1,492 @@
+#pragma once
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+
+#include "block_container.hpp"
+#include "sha256.hpp"
+#include "trace.hpp"
+
+namespace wwstorage {
+
+// FastCDC 内容定义分块：用 gear 滚动哈希找切点，切点只取决于附近 64 字节的内容，
+// 文件中间插入或删除数据后，后面的切点会重新对齐，相同的块仍然切成一样的块。
+// 块长在 [avg/4, avg*4] 之间；达到 avg 之前用更严格的掩码，之后用更宽松的掩码（normalized chunking），
+// 块长更集中在 avg 附近
+class FastCdc {
+public:
+    explicit FastCdc(size_t avg_size)
+    {
+        int bits = 0;
+        while (((size_t)1 << (bits + 1)) <= std::max<size_t>(avg_size, 256)) bits++;
+        avg_ = (size_t)1 << bits;
+        min_ = avg_ / 4;
+        max_ = avg_ * 4;
+        // 取高位：gear 哈希每步左移一位，高位混合了更多历史字节
+        mask_small_ = ~0ULL << (64 - (bits + 2));
+        mask_large_ = ~0ULL << (64 - (bits - 2));
+    }
+
+    size_t MinSize() const { return min_; }
+    size_t AvgSize() const { return avg_; }
+    size_t MaxSize() const { return max_; }
+
+    // 返回 data 里第一个块的长度。len 不足 max_ 时调用方要保证后面没有数据了
+    size_t Cut(const char *data, size_t len) const
+    {
+        if (len <= min_) return len;
+        const uint64_t *gear = Gear();
+        const unsigned char *p = (const unsigned char *)data;
+        size_t end = std::min(len, max_);
+        size_t normal = std::min(avg_, end);
+        uint64_t fp = 0;
+        size_t i = min_;
+        for (; i < normal; i++) {
+            fp = (fp << 1) + gear[p[i]];
+            if ((fp & mask_small_) == 0) return i + 1;
+        }
+        for (; i < end; i++) {
+            fp = (fp << 1) + gear[p[i]];
+            if ((fp & mask_large_) == 0) return i + 1;
+        }
+        return end;
+    }
+
+private:
+    // 固定种子生成的随机表，切点必须在重启后保持不变
+    static const uint64_t *Gear()
+    {
+        static const std::vector<uint64_t> table = []() {
+            std::vector<uint64_t> t(256);
+            uint64_t seed = 0x46524348554e4b53ULL;
+            for (auto &v : t) {
+                uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                v = z ^ (z >> 31);
+            }
+            return t;
+        }();
+        return table.data();
+    }
+
+private:
+    size_t min_;
+    size_t avg_;
+    size_t max_;
+    uint64_t mask_small_;
+    uint64_t mask_large_;
+};
+
+// 块仓库：chunk_dir/<前两位>/<sha256>[.gz|.zst]，内容是按 ContentEncoding 封装的整块压缩结果，
+// 不同封装的同一块各存一份。
+// 块不可变，同样的块并发写入时后 rename 的覆盖先写的，内容一样不影响正在读的人。
+// 引用关系只记在清单里，启动时扫描所有清单做一次标记清除，运行期间不删除块
+class ChunkStore {
+public:
+    ChunkStore(const std::string &chunk_dir, size_t avg_size)
+        : chunk_dir_(chunk_dir), cdc_(avg_size), seq_(0), chunks_(0), dedup_chunks_(0), raw_bytes_(0),
+          stored_bytes_(0)
+    {
+    }
+
+    // manifest_dirs 是可能存放清单的目录（deep_storage、blob 仓库），没被任何清单引用的块会被删除
+    bool Init(const std::vector<std::string> &manifest_dirs);
+
+    // 存一个块，已经存在时不再压缩，*fresh 为 false
+    bool Put(const std::string &hash, const char *data, size_t len, int format, ContentEncoding encoding,
+             bool *fresh)
+    {
+        std::string path = ChunkPath(hash, encoding);
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0) {
+            *fresh = false;
+            dedup_chunks_++;
+            return true;
+        }
+        std::string packed;
+        if (!EncodeFrame(encoding, format, std::string(data, len), &packed)) {
+            wwlog::GetLogger("asynclogger")->Error("chunk compress error: %s", hash.c_str());
+            return false;
+        }
+        File(path.substr(0, path.find_last_of('/') + 1)).CreateDirectory();
+        std::string tmp = chunk_dir_ + ".tmp-" + std::to_string(getpid()) + "-" + std::to_string(seq_++);
+        if (!File(tmp).SetContent(packed.data(), packed.size()) || rename(tmp.c_str(), path.c_str()) == -1) {
+            wwlog::GetLogger("asynclogger")->Error("chunk write %s error: %s", path.c_str(), strerror(errno));
+            remove(tmp.c_str());
+            return false;
+        }
+        *fresh = true;
+        chunks_++;
+        raw_bytes_ += len;
+        stored_bytes_ += packed.size();
+        return true;
+    }
+    bool Get(const std::string &hash, ContentEncoding encoding, uint64_t raw_len, std::string *content)
+    {
+        std::string packed;
+        if (!File(ChunkPath(hash, encoding)).GetContent(&packed)) return false;
+        if (!DecodeFrame(encoding, packed, raw_len, content)) {
+            wwlog::GetLogger("asynclogger")->Error("chunk corrupted: %s", hash.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    static std::string ChunkName(const std::string &hash, ContentEncoding encoding)
+    {
+        if (encoding == kEncodingGzip) return hash + ".gz";
+        if (encoding == kEncodingZstd) return hash + ".zst";
+        return hash;
+    }
+    std::string ChunkPath(const std::string &hash, ContentEncoding encoding) const
+    {
+        return chunk_dir_ + hash.substr(0, 2) + "/" + ChunkName(hash, encoding);
+    }
+    const FastCdc &Chunker() const { return cdc_; }
+    uint64_t Chunks() const { return chunks_; }
+    uint64_t DedupChunks() const { return dedup_chunks_; }
+    // 仓库里块的原始大小和压缩后大小
+    uint64_t RawBytes() const { return raw_bytes_; }
+    uint64_t StoredBytes() const { return stored_bytes_; }
+
+private:
+    std::string chunk_dir_;
+    FastCdc cdc_;
+    std::atomic<uint64_t> seq_;
+    std::atomic<uint64_t> chunks_;
+    std::atomic<uint64_t> dedup_chunks_;
+    std::atomic<uint64_t> raw_bytes_;
+    std::atomic<uint64_t> stored_bytes_;
+};
+
+// deep_storage 块清单格式：
+//   ChunkManifestHeader | ChunkEntry * chunk_count
+// 清单代替压缩文件放在 deep_storage 里，按顺序拼接各块的原始数据就是文件内容
+const char kChunkMagic[4] = {'F', 'R', 'C', 'M'};
+const uint32_t kChunkVersion = 1;
+
+struct ChunkManifestHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t chunk_count;
+    uint64_t raw_size;
+    uint64_t encoding;  // ContentEncoding，所有块的封装方式相同
+};
+
+struct ChunkEntry {
+    char hash[64];  // 十六进制 sha256
+    uint64_t raw_len;
+};
+
+static_assert(sizeof(ChunkManifestHeader) == 32, "ChunkManifestHeader layout changed");
+static_assert(sizeof(ChunkEntry) == 72, "ChunkEntry layout changed");
+
+// 边写边分块：缓冲区攒够 max 字节才找切点，切出的块攒够 threads 个后并行算哈希、压缩新块，
+// 内存占用是 threads 个块加一个 max 大小的缓冲区
+class ChunkWriter {
+public:
+    ChunkWriter(ChunkStore *store, const std::string &file_name, int format, int threads = 1,
+                ContentEncoding encoding = kEncodingBundle)
+        : store_(store), file_name_(file_name), format_(format), threads_(threads > 0 ? threads : 1),
+          encoding_(encoding), fd_(-1), raw_size_(0), fresh_bytes_(0)
+    {
+    }
+    ~ChunkWriter()
+    {
+        if (fd_ != -1) close(fd_);
+    }
+
+    bool Open()
+    {
+        fd_ = open(file_name_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd_ == -1) {
+            wwlog::GetLogger("asynclogger")->Info("%s, manifest open error: %s", file_name_.c_str(), strerror(errno));
+            return false;
+        }
+        return true;
+    }
+    bool Write(const char *data, size_t len)
+    {
+        const FastCdc &cdc = store_->Chunker();
+        buffer_.append(data, len);
+        size_t pos = 0;
+        while (buffer_.size() - pos >= cdc.MaxSize()) {
+            size_t n = cdc.Cut(buffer_.data() + pos, buffer_.size() - pos);
+            if (!AddChunk(buffer_.substr(pos, n))) return false;
+            pos += n;
+        }
+        buffer_.erase(0, pos);
+        return true;
+    }
+    bool Finish()
+    {
+        const FastCdc &cdc = store_->Chunker();
+        for (size_t pos = 0, n; pos < buffer_.size(); pos += n) {
+            n = cdc.Cut(buffer_.data() + pos, buffer_.size() - pos);
+            if (!AddChunk(buffer_.substr(pos, n))) return false;
+        }
+        buffer_.clear();
+        if (!FlushBatch()) return false;
+
+        ChunkManifestHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, kChunkMagic, sizeof(header.magic));
+        header.version = kChunkVersion;
+        header.chunk_count = entries_.size();
+        header.raw_size = raw_size_;
+        header.encoding = encoding_;
+        if (!WriteAll(fd_, (const char *)&header, sizeof(header)) ||
+            !WriteAll(fd_, (const char *)entries_.data(), entries_.size() * sizeof(ChunkEntry))) {
+            wwlog::GetLogger("asynclogger")->Info("%s, manifest write error: %s", file_name_.c_str(), strerror(errno));
+            return false;
+        }
+        close(fd_);
+        fd_ = -1;
+        REQUEST_LOG("%s chunked: %u chunks, %llu of %llu bytes new", file_name_.c_str(), entries_.size(),
+                    (unsigned long long)fresh_bytes_, (unsigned long long)raw_size_);
+        return true;
+    }
+    static bool ChunkFile(ChunkStore *store, const std::string &src, const std::string &dst, int format,
+                          int threads = 1, ContentEncoding encoding = kEncodingBundle)
+    {
+        std::ifstream ifs(src, std::ios::binary);
+        if (ifs.is_open() == false) {
+            wwlog::GetLogger("asynclogger")->Info("%s, file open error.", src.c_str());
+            return false;
+        }
+        ChunkWriter writer(store, dst, format, threads, encoding);
+        if (!writer.Open()) return false;
+        std::string buffer(store->Chunker().MaxSize(), 0);
+        while (ifs) {
+            ifs.read(&buffer[0], buffer.size());
+            if (ifs.gcount() > 0 && !writer.Write(buffer.data(), ifs.gcount())) return false;
+        }
+        if (ifs.bad()) {
+            wwlog::GetLogger("asynclogger")->Info("%s, read file content error.", src.c_str());
+            return false;
+        }
+        return writer.Finish();
+    }
+
+    uint64_t RawSize() const { return raw_size_; }
+    // 这次写入新增到仓库的原始字节数，其余都是和已有块重复的
+    uint64_t FreshBytes() const { return fresh_bytes_; }
+
+private:
+    bool AddChunk(std::string chunk)
+    {
+        batch_.push_back(std::move(chunk));
+        return batch_.size() < (size_t)threads_ || FlushBatch();
+    }
+    bool FlushBatch()
+    {
+        std::vector<ChunkEntry> entries(batch_.size());
+        std::vector<char> fresh(batch_.size(), 0);
+        std::atomic<bool> ok(true);
+        ParallelFor(batch_.size(), threads_, [&](size_t i) {
+            std::string hash = Sha256::Hash(batch_[i]);
+            memcpy(entries[i].hash, hash.data(), sizeof(entries[i].hash));
+            entries[i].raw_len = batch_[i].size();
+            bool is_fresh = false;
+            if (!store_->Put(hash, batch_[i].data(), batch_[i].size(), format_, encoding_, &is_fresh)) ok = false;
+            fresh[i] = is_fresh;
+        });
+        if (!ok) return false;
+        for (size_t i = 0; i < batch_.size(); i++) {
+            entries_.push_back(entries[i]);
+            raw_size_ += batch_[i].size();
+            if (fresh[i]) fresh_bytes_ += batch_[i].size();
+        }
+        batch_.clear();
+        return true;
+    }
+
+private:
+    ChunkStore *store_;
+    std::string file_name_;
+    int format_;
+    int threads_;
+    ContentEncoding encoding_;
+    int fd_;
+    uint64_t raw_size_;
+    uint64_t fresh_bytes_;
+    std::string buffer_;  // 还没找切点的数据
+    std::vector<std::string> batch_;
+    std::vector<ChunkEntry> entries_;
+};
+
+// 读块清单，任意区间只取覆盖到的块，多个块时并行解压
+class ChunkReader {
+public:
+    ChunkReader() : store_(nullptr), threads_(1), encoding_(kEncodingBundle) {}
+
+    // readable 非空时返回文件能不能打开，打不开的文件不知道是不是清单
+    static bool IsChunkFile(const std::string &file_name, bool *readable = nullptr)
+    {
+        char magic[sizeof(kChunkMagic)] = {0};
+        std::ifstream ifs(file_name, std::ios::binary);
+        if (readable) *readable = ifs.is_open();
+        ifs.read(magic, sizeof(magic));
+        return ifs.good() && memcmp(magic, kChunkMagic, sizeof(magic)) == 0;
+    }
+    bool Open(ChunkStore *store, const std::string &file_name)
+    {
+        store_ = store;
+        file_name_ = file_name;
+        std::string content;
+        if (!File(file_name).GetContent(&content) || content.size() < sizeof(ChunkManifestHeader)) {
+            return FormatError();
+        }
+        ChunkManifestHeader header;
+        memcpy(&header, content.data(), sizeof(header));
+        if (memcmp(header.magic, kChunkMagic, 4) != 0 || header.version != kChunkVersion ||
+            header.encoding > kEncodingZstd ||
+            header.chunk_count != (content.size() - sizeof(header)) / sizeof(ChunkEntry) ||
+            (content.size() - sizeof(header)) % sizeof(ChunkEntry) != 0) {
+            return FormatError();
+        }
+        encoding_ = (ContentEncoding)header.encoding;
+        entries_.resize(header.chunk_count);
+        memcpy(entries_.data(), content.data() + sizeof(header), entries_.size() * sizeof(ChunkEntry));
+        // offsets_[i] 是第 i 块在原始数据中的起始位置
+        offsets_.assign(1, 0);
+        for (auto &entry : entries_) offsets_.push_back(offsets_.back() + entry.raw_len);
+        if (offsets_.back() != header.raw_size) return FormatError();
+        return true;
+    }
+    void SetThreads(int threads) { threads_ = threads > 0 ? threads : 1; }
+    uint64_t RawSize() const { return offsets_.empty() ? 0 : offsets_.back(); }
+    size_t ChunkCount() const { return entries_.size(); }
+    std::string ChunkHash(size_t i) const { return std::string(entries_[i].hash, sizeof(entries_[i].hash)); }
+    uint64_t ChunkRawSize(size_t i) const { return entries_[i].raw_len; }
+    ContentEncoding Encoding() const { return encoding_; }
+    // 第 i 块在仓库里的文件，encoding 不是 bundle 时按顺序拼接各块文件就是编码后的响应体
+    std::string ChunkPath(size_t i) const { return store_->ChunkPath(ChunkHash(i), encoding_); }
+
+    bool ReadRange(uint64_t pos, uint64_t len, std::string *content)
+    {
+        content->clear();
+        if (pos + len > RawSize()) {
+            wwlog::GetLogger("asynclogger")->Info("needed data larger than file size.");
+            return false;
+        }
+        content->reserve(len);
+        std::vector<std::string> chunks;
+        size_t i = std::upper_bound(offsets_.begin(), offsets_.end(), pos) - offsets_.begin() - 1;
+        while (len > 0 && i < entries_.size()) {
+            size_t last = std::upper_bound(offsets_.begin(), offsets_.end(), pos + len - 1) - offsets_.begin() - 1;
+            size_t count = std::min<size_t>(threads_, last - i + 1);
+            if (!ReadChunks(i, count, &chunks)) return false;
+            for (auto &chunk : chunks) {
+                uint64_t skip = pos - offsets_[i];
+                uint64_t n = std::min<uint64_t>(len, chunk.size() - skip);
+                content->append(chunk, skip, n);
+                pos += n;
+                len -= n;
+                i++;
+            }
+        }
+        return len == 0;
+    }
+    bool ReadChunks(size_t first, size_t count, std::vector<std::string> *chunks)
+    {
+        chunks->resize(count);
+        std::atomic<bool> ok(true);
+        ParallelFor(count, threads_, [&](size_t i) {
+            if (!store_->Get(ChunkHash(first + i), encoding_, entries_[first + i].raw_len, &(*chunks)[i])) ok = false;
+        });
+        return ok;
+    }
+    bool DecodeTo(const std::string &dst)
+    {
+        std::ofstream ofs(dst, std::ios::binary | std::ios::trunc);
+        if (ofs.is_open() == false) {
+            wwlog::GetLogger("asynclogger")->Info("%s, file open error.", dst.c_str());
+            return false;
+        }
+        std::vector<std::string> chunks;
+        for (size_t i = 0; i < entries_.size(); i += chunks.size()) {
+            if (!ReadChunks(i, std::min<size_t>(threads_, entries_.size() - i), &chunks)) return false;
+            for (auto &chunk : chunks) ofs.write(chunk.data(), chunk.size());
+        }
+        ofs.close();
+        if (!ofs.good()) {
+            wwlog::GetLogger("asynclogger")->Info("%s, write file content error.", dst.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool FormatError()
+    {
+        wwlog::GetLogger("asynclogger")->Info("%s, chunk manifest corrupted.", file_name_.c_str());
+        return false;
+    }
+
+private:
+    ChunkStore *store_;
+    std::string file_name_;
+    int threads_;
+    ContentEncoding encoding_;
+    std::vector<ChunkEntry> entries_;
+    std::vector<uint64_t> offsets_;
+};
+
+inline bool ChunkStore::Init(const std::vector<std::string> &manifest_dirs)
+{
+    if (!File(chunk_dir_).CreateDirectory()) return false;
+    std::unordered_map<std::string, uint64_t> live;  // 被引用的块 -> 原始大小
+    // 有清单读不出来时不知道哪些块还在用，这次只统计不回收：留下垃圾块总比删掉文件的数据好
+    bool collect = true;
+    try {
+        for (auto &dir : manifest_dirs) {
+            if (dir.empty() || !File(dir).Exists()) continue;
+            for (auto &entry : std::filesystem::recursive_directory_iterator(dir)) {
+                std::string path = entry.path().string();
+                if (!entry.is_regular_file()) continue;
+                bool readable = false;
+                if (!ChunkReader::IsChunkFile(path, &readable) && readable) continue;
+                ChunkReader reader;
+                if (!readable || !reader.Open(this, path)) {
+                    wwlog::GetLogger("asynclogger")->Error("chunk store: %s unreadable, skip collecting", path.c_str());
+                    collect = false;
+                    continue;
+                }
+                for (size_t i = 0; i < reader.ChunkCount(); i++) {
+                    live[ChunkName(reader.ChunkHash(i), reader.Encoding())] = reader.ChunkRawSize(i);
+                }
+            }
+        }
+    } catch (const std::filesystem::filesystem_error &e) {
+        wwlog::GetLogger("asynclogger")->Error("chunk store: scan manifests error: %s, skip collecting", e.what());
+        collect = false;
+    }
+    size_t collected = 0;
+    try {
+        for (auto &entry : std::filesystem::recursive_directory_iterator(chunk_dir_)) {
+            if (!entry.is_regular_file()) continue;
+            auto it = live.find(entry.path().filename().string());
+            if (it == live.end() && collect) {
+                remove(entry.path().c_str());
+                collected++;
+                continue;
+            }
+            chunks_++;
+            if (it != live.end()) raw_bytes_ += it->second;
+            stored_bytes_ += entry.file_size();
+        }
+    } catch (const std::filesystem::filesystem_error &e) {
+        wwlog::GetLogger("asynclogger")->Error("chunk store: scan %s error: %s", chunk_dir_.c_str(), e.what());
+    }
+    wwlog::GetLogger("asynclogger")
+        ->Info("chunk store loaded: %llu chunks, %llu bytes, collected: %u", (unsigned long long)chunks_.load(),
+               (unsigned long long)stored_bytes_.load(), collected);
+    return true;
+}
+
+}  // namespace wwstorage
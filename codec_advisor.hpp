@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <random>
+
+#include "codec_selector.hpp"
+#include "deep_file.hpp"
+
+namespace wwstorage {
+
+// 一种编码在所有样本上的累计结果
+struct CodecScore {
+    unsigned codec;
+    bool pass;  // 所有样本都能正确往返
+    uint64_t raw_bytes;
+    uint64_t packed_bytes;
+    double enc_us;
+    double dec_us;
+
+    double Ratio() const { return raw_bytes == 0 ? 1.0 : (double)packed_bytes / raw_bytes; }
+    double EncMBps() const { return raw_bytes / 1048576.0 / std::max(enc_us, 1.0) * 1e6; }
+    double DecMBps() const { return raw_bytes / 1048576.0 / std::max(dec_us, 1.0) * 1e6; }
+};
+
+// 各个取舍方向允许的最低压缩/解压速度（MB/s），在这个 CPU 预算内选压缩后最小的编码
+struct CodecBudget {
+    double min_enc_mb_s;
+    double min_dec_mb_s;
+
+    static CodecBudget ForTarget(CodecTarget target)
+    {
+        if (target == kCodecSpeed) return {200, 500};
+        if (target == kCodecRatio) return {5, 50};
+        return {50, 200};
+    }
+};
+
+// 编码选型：从 low/deep 目录里随机抽取文件，每个取开头最多 sample_bytes 的原始内容，
+// 用 bundle::measures 跑一遍所有编码，统计压缩率和压缩/解压速度，再按 CPU 预算推荐 bundle_format。
+// 只读存储目录，可以在服务运行时使用；测量很耗 CPU，不要放在事件循环线程里
+class CodecAdvisor {
+public:
+    CodecAdvisor(const std::string &low_dir, const std::string &deep_dir, size_t max_files, size_t sample_bytes)
+        : low_dir_(low_dir), deep_dir_(deep_dir), max_files_(max_files), sample_bytes_(sample_bytes)
+    {
+    }
+
+    // slow 为 true 时连 LZIP/ZPAQ 这类很慢的编码也测；返回实际用到的样本数
+    size_t Run(bool slow, std::vector<CodecScore> *scores)
+    {
+        std::vector<std::string> samples;
+        Sample(&samples);
+        std::vector<unsigned> codecs = slow ? bundle::encodings() : bundle::fast_encodings();
+        scores->clear();
+        for (unsigned codec : codecs) scores->push_back({codec, true, 0, 0, 0, 0});
+        for (auto &sample : samples) {
+            auto results = bundle::measures(sample, codecs);
+            for (size_t i = 0; i < results.size(); i++) {
+                CodecScore &score = (*scores)[i];
+                score.pass = score.pass && results[i].pass;
+                score.raw_bytes += sample.size();
+                score.packed_bytes += results[i].packed.size();
+                score.enc_us += results[i].enctime;
+                score.dec_us += results[i].dectime;
+            }
+        }
+        return samples.size();
+    }
+
+    // 压缩后不到原始大小 raw_ratio 的编码才算有收益，都没有收益时推荐 RAW；
+    // 否则在预算内选压缩后最小的，预算内没有就选压缩加解压最快的
+    static unsigned Recommend(const std::vector<CodecScore> &scores, const CodecBudget &budget, double raw_ratio)
+    {
+        const CodecScore *smallest = nullptr, *fastest = nullptr;
+        for (auto &score : scores) {
+            if (!score.pass || score.codec == bundle::RAW || score.raw_bytes == 0 || score.Ratio() >= raw_ratio) {
+                continue;
+            }
+            if (fastest == nullptr || score.enc_us + score.dec_us < fastest->enc_us + fastest->dec_us) {
+                fastest = &score;
+            }
+            if (score.EncMBps() < budget.min_enc_mb_s || score.DecMBps() < budget.min_dec_mb_s) continue;
+            if (smallest == nullptr || score.packed_bytes < smallest->packed_bytes) smallest = &score;
+        }
+        if (smallest) return smallest->codec;
+        return fastest ? fastest->codec : (unsigned)bundle::RAW;
+    }
+
+private:
+    // 蓄水池抽样，种子固定，同样的目录内容每次抽到同样的文件
+    void Sample(std::vector<std::string> *samples)
+    {
+        std::vector<std::pair<std::string, bool>> picked;
+        std::mt19937_64 rng(0);
+        size_t seen = 0;
+        for (bool deep : {false, true}) {
+            const std::string &dir = deep ? deep_dir_ : low_dir_;
+            if (dir.empty() || !File(dir).Exists()) continue;
+            for (auto &entry : std::filesystem::directory_iterator(dir)) {
+                // 跳过迁移和流式上传的临时文件
+                if (!entry.is_regular_file() || entry.path().filename().string()[0] == '.') continue;
+                std::pair<std::string, bool> item(entry.path().string(), deep);
+                if (picked.size() < max_files_) {
+                    picked.push_back(item);
+                } else if (size_t slot = rng() % (seen + 1); slot < max_files_) {
+                    picked[slot] = item;
+                }
+                seen++;
+            }
+        }
+        for (auto &item : picked) {
+            std::string content;
+            if (Read(item.first, item.second, &content) && !content.empty()) samples->push_back(std::move(content));
+        }
+        wwlog::GetLogger("asynclogger")->Info("codec advisor sampled %u of %u files", samples->size(), seen);
+    }
+    bool Read(const std::string &path, bool deep, std::string *content)
+    {
+        if (!deep) {
+            File file(path);
+            int64_t size = file.Size();
+            return size >= 0 && file.GetPosLen(content, 0, std::min<uint64_t>(size, sample_bytes_));
+        }
+        DeepFile file;
+        if (!file.Open(path)) return false;
+        return file.ReadRange(0, std::min<uint64_t>(file.RawSize(), sample_bytes_), content);
+    }
+
+private:
+    std::string low_dir_;
+    std::string deep_dir_;
+    size_t max_files_;
+    size_t sample_bytes_;
+};
+
+}  // namespace wwstorage
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <event2/event.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace wwstorage {
+
+// 压缩/解压等 CPU 密集的工作交给固定数量的线程执行，事件循环只做网络 I/O。
+// work 在池线程里执行，执行完后用 event_base_once 把 done 投递回提交它的 event_base，
+// 所以 done 里可以安全地操作 evhttp_request/bufferevent。
+// 队列有上限，满了 Submit 直接返回 false，由调用方回复 503
+class CodecPool {
+public:
+    typedef std::function<void()> Task;
+
+    CodecPool(int threads, size_t max_queue)
+        : threads_(threads > 0 ? threads : 1),
+          max_queue_(max_queue > 0 ? max_queue : 1),
+          stop_(false),
+          running_(0),
+          max_depth_(0),
+          submitted_(0),
+          rejected_(0),
+          completed_(0)
+    {
+    }
+    ~CodecPool() { Stop(); }
+
+    void Start()
+    {
+        for (int i = 0; i < threads_; i++) workers_.emplace_back(&CodecPool::Run, this);
+    }
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+        for (auto &worker : workers_) worker.join();
+        workers_.clear();
+    }
+    bool Submit(event_base *base, const Task &work, const Task &done)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stop_ || queue_.size() >= max_queue_) {
+            rejected_++;
+            wwlog::GetLogger("asynclogger")->Warn("codec pool queue full, depth: %u", queue_.size());
+            return false;
+        }
+        queue_.push_back(new Job{base, work, done});
+        submitted_++;
+        if (queue_.size() > max_depth_) max_depth_ = queue_.size();
+        cv_.notify_one();
+        return true;
+    }
+
+    size_t QueueDepth()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+    size_t MaxQueueDepth()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return max_depth_;
+    }
+    int Running() const { return running_; }
+    uint64_t Submitted() const { return submitted_; }
+    uint64_t Rejected() const { return rejected_; }
+    uint64_t Completed() const { return completed_; }
+
+private:
+    struct Job {
+        event_base *base;
+        Task work;
+        Task done;
+    };
+
+    void Run()
+    {
+        while (true) {
+            Job *job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+                if (queue_.empty()) return;
+                job = queue_.front();
+                queue_.pop_front();
+            }
+            running_++;
+            job->work();
+            running_--;
+            completed_++;
+            if (event_base_once(job->base, -1, EV_TIMEOUT, Complete, job, nullptr) == -1) {
+                wwlog::GetLogger("asynclogger")->Error("codec pool post completion error.");
+                delete job;
+            }
+        }
+    }
+    // 在提交任务的 event_base 线程里执行
+    static void Complete(evutil_socket_t fd, short events, void *arg)
+    {
+        Job *job = (Job *)arg;
+        job->done();
+        delete job;
+    }
+
+private:
+    int threads_;
+    size_t max_queue_;
+
+    std::mutex mutex_;  // 保护 queue_、stop_、max_depth_
+    std::condition_variable cv_;
+    std::deque<Job *> queue_;
+    bool stop_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<int> running_;
+    size_t max_depth_;
+    std::atomic<uint64_t> submitted_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> completed_;
+};
+
+}  // namespace wwstorage
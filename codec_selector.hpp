@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cmath>
+#include <string>
+
+#include "trace.hpp"
+
+namespace wwstorage {
+
+// adaptive 模式下的取舍方向：speed 选 LZ4，balanced 选 ZSTD，ratio 选 LZMA20
+enum CodecTarget { kCodecSpeed, kCodecBalanced, kCodecRatio };
+
+static CodecTarget ParseCodecTarget(const std::string &target)
+{
+    if (target == "speed") return kCodecSpeed;
+    if (target == "ratio") return kCodecRatio;
+    return kCodecBalanced;
+}
+
+struct CodecPolicy {
+    CodecTarget target;
+    double raw_entropy;  // 样本熵（bit/字节）不低于它就不压缩
+    double raw_ratio;    // LZ4 试压缩后的大小/原始大小不低于它就不压缩
+};
+
+// 字节分布的香农熵，0~8 bit/字节，JPEG/MP4/zip 这类已压缩数据接近 8
+static double SampleEntropy(const char *data, size_t len)
+{
+    if (len == 0) return 0;
+    size_t counts[256] = {0};
+    for (size_t i = 0; i < len; i++) counts[(unsigned char)data[i]]++;
+    double entropy = 0;
+    for (size_t count : counts) {
+        if (count == 0) continue;
+        double p = (double)count / len;
+        entropy -= p * std::log2(p);
+    }
+    return entropy;
+}
+
+// 根据文件开头的样本挑选 bundle 编码：先用熵筛掉明显不可压缩的数据，
+// 再用最快的 LZ4 试压缩一次，收益太小同样存 RAW，否则按 target 选编码
+static int ChooseCodec(const char *sample, size_t len, const CodecPolicy &policy)
+{
+    if (len == 0) return bundle::RAW;
+    double entropy = SampleEntropy(sample, len);
+    if (entropy >= policy.raw_entropy) {
+        REQUEST_LOG("choose codec RAW, entropy: %.3f", entropy);
+        return bundle::RAW;
+    }
+    std::string trial = bundle::pack(bundle::LZ4, std::string(sample, len));
+    double ratio = trial.empty() ? 1.0 : (double)trial.size() / len;
+    int codec;
+    if (ratio >= policy.raw_ratio) {
+        codec = bundle::RAW;
+    } else if (policy.target == kCodecSpeed) {
+        codec = bundle::LZ4;
+    } else if (policy.target == kCodecRatio) {
+        codec = bundle::LZMA20;
+    } else {
+        codec = bundle::ZSTD;
+    }
+    REQUEST_LOG("choose codec %s, entropy: %.3f, lz4 ratio: %.3f", bundle::name_of((unsigned)codec), entropy, ratio);
+    return codec;
+}
+
+}  // namespace wwstorage
@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <mutex>
+#include <thread>
 
 #include "utils.hpp"
 
@@ -29,7 +30,42 @@ public:
         deep_storage_dir_ = root["deep_storage_dir"].asString();
         low_storage_dir_ = root["low_storage_dir"].asString();
         storage_info_ = root["storage_info"].asString();
+        storage_format_ = root.get("storage_format", "json").asString();
         bundle_format_ = root["bundle_format"].asInt();
+        deep_block_size_ = root.get("deep_block_size", 1024 * 1024).asUInt();
+        storage_journal_ = root.get("storage_journal", storage_info_ + ".journal").asString();
+        journal_checkpoint_ = root.get("journal_checkpoint", 1024).asInt();
+        table_shards_ = root.get("table_shards", 16).asInt();
+        durability_ = root.get("durability", "batch").asString();
+        persist_interval_ms_ = root.get("persist_interval_ms", 100).asInt();
+        persist_batch_ = root.get("persist_batch", 256).asInt();
+        upload_stream_port_ = root.get("upload_stream_port", 0).asInt();
+        upload_stream_buffer_ = root.get("upload_stream_buffer", 256 * 1024).asUInt();
+        cache_dir_ = root.get("cache_dir", "./cache/").asString();
+        cache_bytes_ = root.get("cache_bytes", (Json::UInt64)1024 * 1024 * 1024).asUInt64();
+        worker_threads_ = root.get("worker_threads", 0).asInt();
+        codec_threads_ = root.get("codec_threads", 0).asInt();
+        codec_queue_ = root.get("codec_queue", 64).asUInt();
+        compress_threads_ = root.get("compress_threads", 0).asInt();
+        codec_mode_ = root.get("codec_mode", "fixed").asString();
+        codec_target_ = root.get("codec_target", "balanced").asString();
+        codec_sample_bytes_ = root.get("codec_sample_bytes", 256 * 1024).asUInt();
+        codec_raw_entropy_ = root.get("codec_raw_entropy", 7.5).asDouble();
+        codec_raw_ratio_ = root.get("codec_raw_ratio", 0.95).asDouble();
+        blob_dir_ = root.get("blob_dir", "").asString();
+        chunk_dir_ = root.get("chunk_dir", "").asString();
+        chunk_avg_size_ = root.get("chunk_avg_size", 512 * 1024).asUInt();
+        deep_content_encoding_ = root.get("deep_content_encoding", "").asString();
+        deep_gzip_max_size_ = root.get("deep_gzip_max_size", (Json::UInt64)64 * 1024 * 1024).asUInt64();
+        file_cache_entries_ = root.get("file_cache_entries", 0).asUInt();
+        file_cache_inotify_ = root.get("file_cache_inotify", false).asBool();
+        tier_interval_sec_ = root.get("tier_interval_sec", 0).asInt();
+        tier_cold_seconds_ = root.get("tier_cold_seconds", 7 * 24 * 3600).asInt64();
+        tier_hot_hits_ = root.get("tier_hot_hits", 8).asUInt();
+        tier_rate_bytes_ = root.get("tier_rate_bytes", (Json::UInt64)32 * 1024 * 1024).asUInt64();
+        codec_advisor_api_ = root.get("codec_advisor_api", false).asBool();
+        trace_spans_ = root.get("trace_spans", 0).asUInt();
+        trace_dump_path_ = root.get("trace_dump_path", "./traces.json").asString();
 
         return true;
     }
@@ -50,7 +86,66 @@ public:
     std::string GetDeepStorageDir() { return deep_storage_dir_; }
     std::string GetLowStorageDir() { return low_storage_dir_; }
     std::string GetStorageInfo() { return storage_info_; }
+    std::string GetStorageFormat() { return storage_format_; }
     int GetBundleFormat() { return bundle_format_; }
+    size_t GetDeepBlockSize() { return deep_block_size_; }
+    std::string GetStorageJournal() { return storage_journal_; }
+    int GetJournalCheckpoint() { return journal_checkpoint_; }
+    int GetTableShards() { return table_shards_; }
+    std::string GetDurability() { return durability_; }
+    int GetPersistIntervalMs() { return persist_interval_ms_; }
+    int GetPersistBatch() { return persist_batch_; }
+    int GetUploadStreamPort() { return upload_stream_port_; }
+    size_t GetUploadStreamBuffer() { return upload_stream_buffer_; }
+    std::string GetCacheDir() { return cache_dir_; }
+    uint64_t GetCacheBytes() { return cache_bytes_; }
+    // 0 表示按 CPU 核数启动
+    int GetWorkerThreads() { return worker_threads_; }
+    // 0 表示按 CPU 核数启动
+    int GetCodecThreads()
+    {
+        return codec_threads_ > 0 ? codec_threads_ : std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t GetCodecQueue() { return codec_queue_; }
+    // 单个 deep 文件分块并行压缩/解压的线程数，0 表示按 CPU 核数
+    int GetCompressThreads()
+    {
+        return compress_threads_ > 0 ? compress_threads_ : std::max(1u, std::thread::hardware_concurrency());
+    }
+    // fixed: 所有 deep 文件都用 bundle_format；adaptive: 按每个文件开头的样本挑选编码
+    std::string GetCodecMode() { return codec_mode_; }
+    std::string GetCodecTarget() { return codec_target_; }
+    size_t GetCodecSampleBytes() { return codec_sample_bytes_; }
+    double GetCodecRawEntropy() { return codec_raw_entropy_; }
+    double GetCodecRawRatio() { return codec_raw_ratio_; }
+    // 内容去重的 blob 仓库目录，为空表示不去重；必须和存储目录在同一个文件系统上（硬链接）
+    std::string GetBlobDir() { return blob_dir_; }
+    // deep 文件按内容定义分块去重的块仓库目录，为空表示 deep 文件仍按 deep_block_size 写分块容器
+    std::string GetChunkDir() { return chunk_dir_; }
+    // 平均块长，按 2 的幂取整，实际块长在 1/4 到 4 倍之间
+    size_t GetChunkAvgSize() { return chunk_avg_size_; }
+    // gzip/zstd：deep 文件按这种 HTTP 编码存储，接受它的客户端下载时不用解压；为空表示用 bundle 格式
+    std::string GetDeepContentEncoding() { return deep_content_encoding_; }
+    // gzip 的 deep 文件只能整个压成一个块，压缩时整个文件都在内存里；超过这个大小的文件改用 zstd 分块
+    uint64_t GetDeepGzipMaxSize() { return deep_gzip_max_size_; }
+    // 缓存打开的存储文件 fd 的个数，0 表示不缓存；要给连接留够 fd，不要超过 ulimit -n 的一半
+    size_t GetFileCacheEntries() { return file_cache_entries_; }
+    // 用 inotify 监视存储目录，外部改动文件时让缓存失效；关闭时只有本服务的上传会让缓存失效
+    bool GetFileCacheInotify() { return file_cache_inotify_; }
+    // 冷热分层的扫描间隔，0 表示不自动迁移，文件一直留在上传时选的层
+    int GetTierIntervalSec() { return tier_interval_sec_; }
+    // low 文件超过这么多秒没有被下载就压缩进 deep
+    int64_t GetTierColdSeconds() { return tier_cold_seconds_; }
+    // deep 文件的访问热度（每轮扫描减半的下载次数）达到这个值就解压回 low
+    uint32_t GetTierHotHits() { return tier_hot_hits_; }
+    // 迁移每秒最多处理的字节数，0 表示不限速
+    uint64_t GetTierRateBytes() { return tier_rate_bytes_; }
+    // 开放 /api/codecs 编码选型接口；测量会占满一个 codec 线程几秒到几分钟，只给管理员在内网用
+    bool GetCodecAdvisorApi() { return codec_advisor_api_; }
+    // 每个线程保留最近多少个追踪 span，0 表示关闭追踪（/debug/traces 和 SIGUSR1 都不可用）
+    size_t GetTraceSpans() { return trace_spans_; }
+    // 收到 SIGUSR1 时把追踪写到这个文件，每次覆盖
+    std::string GetTraceDumpPath() { return trace_dump_path_; }
 
 
 private:
@@ -72,7 +167,42 @@ private:
     std::string deep_storage_dir_;
     std::string low_storage_dir_;
     std::string storage_info_;
+    std::string storage_format_;
     int bundle_format_;
+    size_t deep_block_size_;
+    std::string storage_journal_;
+    int journal_checkpoint_;
+    int table_shards_;
+    std::string durability_;
+    int persist_interval_ms_;
+    int persist_batch_;
+    int upload_stream_port_;
+    size_t upload_stream_buffer_;
+    std::string cache_dir_;
+    uint64_t cache_bytes_;
+    int worker_threads_;
+    int codec_threads_;
+    size_t codec_queue_;
+    int compress_threads_;
+    std::string codec_mode_;
+    std::string codec_target_;
+    size_t codec_sample_bytes_;
+    double codec_raw_entropy_;
+    double codec_raw_ratio_;
+    std::string blob_dir_;
+    std::string chunk_dir_;
+    size_t chunk_avg_size_;
+    std::string deep_content_encoding_;
+    uint64_t deep_gzip_max_size_;
+    size_t file_cache_entries_;
+    bool file_cache_inotify_;
+    int tier_interval_sec_;
+    int64_t tier_cold_seconds_;
+    uint32_t tier_hot_hits_;
+    uint64_t tier_rate_bytes_;
+    bool codec_advisor_api_;
+    size_t trace_spans_;
+    std::string trace_dump_path_;
 };
 
 std::mutex Config::mutex_;
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace wwstorage {
+
+// deep 文件里每个块/分块的封装方式。bundle 是带 bundle 头的 bundle::pack 结果；
+// gzip 是完整的 gzip member（MINIZ 的 raw deflate 加上 gzip 头尾），zstd 是标准的 zstd frame。
+// 多个 gzip member 或 zstd frame 首尾相接仍然是合法的流，整个文件可以带 Content-Encoding 原样发出
+enum ContentEncoding { kEncodingBundle = 0, kEncodingGzip = 1, kEncodingZstd = 2 };
+
+static ContentEncoding ParseContentEncoding(const std::string &name)
+{
+    if (name == "gzip") return kEncodingGzip;
+    if (name == "zstd") return kEncodingZstd;
+    return kEncodingBundle;
+}
+
+// HTTP Content-Encoding 里的名字，bundle 没有对应的名字
+static const char *ContentEncodingName(ContentEncoding encoding)
+{
+    if (encoding == kEncodingGzip) return "gzip";
+    if (encoding == kEncodingZstd) return "zstd";
+    return "";
+}
+
+// Accept-Encoding 里是否接受 name，q=0 表示明确拒绝，明确列出的优先于 *
+static bool AcceptsEncoding(const char *accept, const std::string &name)
+{
+    if (accept == nullptr || name.empty()) return false;
+    std::string header(accept);
+    int star = -1;
+    size_t pos = 0;
+    while (pos < header.size()) {
+        size_t end = header.find(',', pos);
+        if (end == std::string::npos) end = header.size();
+        std::string item = header.substr(pos, end - pos);
+        pos = end + 1;
+        size_t semi = item.find(';');
+        std::string token = item.substr(0, semi);
+        token.erase(0, token.find_first_not_of(" \t"));
+        token.erase(token.find_last_not_of(" \t") + 1);
+        if (token != name && token != "*") continue;
+        size_t q = semi == std::string::npos ? std::string::npos : item.find("q=", semi);
+        bool accepted = q == std::string::npos || atof(item.c_str() + q + 2) > 0;
+        if (token == name) return accepted;
+        star = accepted;
+    }
+    return star == 1;
+}
+
+static uint32_t Crc32(const char *data, size_t len)
+{
+    static const std::vector<uint32_t> table = []() {
+        std::vector<uint32_t> t(256);
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < len; i++) crc = table[(crc ^ (unsigned char)data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFF;
+}
+
+// 把一块原始数据封装成 encoding 格式，bundle 时用 format 指定的编码，gzip/zstd 的编码是固定的
+static bool EncodeFrame(ContentEncoding encoding, int format, const std::string &raw, std::string *frame)
+{
+    if (encoding == kEncodingBundle) {
+        *frame = bundle::pack(format, raw);
+        return !frame->empty();
+    }
+    static const char kGzipHeader[10] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'};
+    unsigned codec = encoding == kEncodingGzip ? bundle::MINIZ : bundle::ZSTD;
+    size_t head = encoding == kEncodingGzip ? sizeof(kGzipHeader) : 0;
+    size_t zlen = bundle::bound(codec, raw.size());
+    frame->resize(head + zlen + 8);
+    if (!bundle::pack(codec, raw.data(), raw.size(), &(*frame)[head], zlen)) return false;
+    frame->resize(head + zlen);
+    if (encoding == kEncodingGzip) {
+        memcpy(&(*frame)[0], kGzipHeader, sizeof(kGzipHeader));
+        uint32_t trailer[2] = {Crc32(raw.data(), raw.size()), (uint32_t)raw.size()};  // 小端
+        frame->append((const char *)trailer, sizeof(trailer));
+    }
+    return true;
+}
+
+// 解开 EncodeFrame 的结果，raw_len 是原始大小，gzip 同时校验 crc32
+static bool DecodeFrame(ContentEncoding encoding, const std::string &frame, uint64_t raw_len, std::string *raw)
+{
+    if (encoding == kEncodingBundle) {
+        *raw = bundle::unpack(frame);
+        return raw->size() == raw_len;
+    }
+    unsigned codec = encoding == kEncodingGzip ? bundle::MINIZ : bundle::ZSTD;
+    const char *payload = frame.data();
+    size_t payload_len = frame.size();
+    if (encoding == kEncodingGzip) {
+        if (frame.size() < 18 || frame[0] != '\x1f' || frame[1] != '\x8b') return false;
+        payload += 10;
+        payload_len -= 18;
+    }
+    raw->resize(raw_len);
+    size_t out_len = raw_len;
+    if (!bundle::unpack(codec, payload, payload_len, &(*raw)[0], out_len) || out_len != raw_len) return false;
+    if (encoding == kEncodingGzip) {
+        uint32_t crc;
+        memcpy(&crc, frame.data() + frame.size() - 8, sizeof(crc));
+        if (crc != Crc32(raw->data(), raw->size())) return false;
+    }
+    return true;
+}
+
+}  // namespace wwstorage
@@ -1,55 +1,57 @@
 #pragma once
 
-#include <pthread.h>
+#include <atomic>
 
-#include <unordered_map>
-
-#include "config.hpp"
+#include "index_format.hpp"
+#include "journal.hpp"
+#include "persister.hpp"
+#include "storage_table.hpp"
 
 namespace wwstorage {
 
-typedef struct StorageInfo {
-    time_t mtime_;
-    time_t atime_;
-    size_t fsize_;
-    std::string storage_path_;
-    std::string url_;
-
-    bool NewStorageInfo(const std::string &storage_path)
-    {
-        wwlog::GetLogger("asynclogger")->Info("NewStoarageInfo start.");
-        File info_file(storage_path);
-        if (!info_file.Exists()) {
-            wwlog::GetLogger("asynclogger")->Info("info file not exists.");
-            return false;
-        }
-        mtime_ = info_file.LastModifyTime();
-        atime_ = info_file.LastAccessTime();
-        fsize_ = info_file.Size();
-        storage_path_ = storage_path;
-        wwstorage::Config *config = wwstorage::Config::GetInstance();
-        url_ = config->GetDownloadPrefix() + info_file.FileName();
-        wwlog::GetLogger("asynclogger")
-            ->Info("download_url:%s, mtime:%s, atime:%s, fsize:%u", url_.c_str(), ctime(&mtime_), ctime(&atime_),
-                   fsize_);
-        wwlog::GetLogger("asynclogger")->Info("NewStorageInfo end.");
-        return true;
-    }
-} StorageInfo;
-
 class DataManager {
 public:
     DataManager()
     {
         wwlog::GetLogger("asynclogger")->Info("DataManager construct start.");
         storage_file_ = wwstorage::Config::GetInstance()->GetStorageInfo();
-        pthread_rwlock_init(&rwlock_, NULL);
+        storage_format_ = wwstorage::Config::GetInstance()->GetStorageFormat();
+        checkpoint_records_ = wwstorage::Config::GetInstance()->GetJournalCheckpoint();
+        durability_ = ParseDurability(wwstorage::Config::GetInstance()->GetDurability());
+        journal_.reset(new Journal(wwstorage::Config::GetInstance()->GetStorageJournal()));
+        table_.reset(new StorageTable(wwstorage::Config::GetInstance()->GetTableShards()));
         need_presist_ = false;
+        generation_ = 0;
         InitLoad();
         need_presist_ = true;
+        journal_->Open();
+        persister_.reset(new Persister(journal_.get(), durability_, wwstorage::Config::GetInstance()->GetPersistIntervalMs(),
+                                       wwstorage::Config::GetInstance()->GetPersistBatch(), checkpoint_records_,
+                                       [this]() { return Storage(); }));
+        persister_->Start();
         wwlog::GetLogger("asynclogger")->Info("DataManager construct end.");
     }
-    ~DataManager() { pthread_rwlock_destroy(&rwlock_); }
+    ~DataManager()
+    {
+        if (persister_) persister_->Stop();
+    }
+
+    static void ToJson(const StorageInfo &info, Json::Value *item)
+    {
+        (*item)["mtime_"] = (Json::Int64)info.mtime_;
+        (*item)["atime_"] = (Json::Int64)info.atime_;
+        (*item)["fsize_"] = (Json::Int64)info.fsize_;
+        (*item)["url_"] = info.url_.c_str();
+        (*item)["storage_path_"] = info.storage_path_.c_str();
+    }
+    static void FromJson(const Json::Value &item, StorageInfo *info)
+    {
+        info->fsize_ = item["fsize_"].asInt64();
+        info->mtime_ = (time_t)item["mtime_"].asInt64();
+        info->atime_ = (time_t)item["atime_"].asInt64();
+        info->url_ = item["url_"].asString();
+        info->storage_path_ = item["storage_path_"].asString();
+    }
 
     bool InitLoad()
     {
@@ -57,27 +59,55 @@ public:
         wwstorage::File storage_file(storage_file_);
         if (!storage_file.Exists()) {
             wwlog::GetLogger("asynclogger")->Info("there is no storage file info need to load.");
-            return true;
+        } else if (IndexMap::IsIndexFile(storage_file_)) {
+            // 二进制快照：映射并校验后直接建表，不需要解析
+            IndexMap index;
+            if (!index.Open(storage_file_)) return false;
+            table_->Reserve(index.Size());
+            for (size_t i = 0; i < index.Size(); i++) {
+                IndexEntry entry = index.Get(i);
+                StorageInfo info;
+                info.mtime_ = entry.mtime;
+                info.atime_ = entry.atime;
+                info.fsize_ = entry.fsize;
+                info.url_.assign(entry.url);
+                info.storage_path_.assign(entry.storage_path);
+                table_->Put(info);
+            }
+        } else {
+            std::string body;
+            if (!storage_file.GetContent(&body)) return false;
+
+            Json::Value root;
+            wwstorage::JsonConveter::FromJsonString(body, &root);
+            table_->Reserve(root.size());
+            for (int i = 0; i < root.size(); i++) {
+                StorageInfo info;
+                FromJson(root[i], &info);
+                table_->Put(info);
+            }
         }
+        wwlog::GetLogger("asynclogger")->Info("storage file loaded entries: %u", table_->Size());
 
-        std::string body;
-        if (!storage_file.GetContent(&body)) return false;
-
-        Json::Value root;
-        wwstorage::JsonConveter::FromJsonString(body, &root);
-        for (int i = 0; i < root.size(); i++) {
+        // 快照之后的修改都在日志里，按顺序回放
+        size_t replayed = journal_->Replay([this](const std::string &line) {
+            // 解析不了或缺少 url/路径的记录跳过，不能把空条目带进表和之后的快照
+            Json::Value item;
             StorageInfo info;
-            info.fsize_ = root[i]["fsize_"].asInt();
-            info.mtime_ = (time_t)root[i]["mtime_"].asInt64();
-            info.atime_ = (time_t)root[i]["atime_"].asInt64();
-            info.url_ = root[i]["url_"].asString();
-            info.storage_path_ = root[i]["storage_path_"].asString();
+            if (wwstorage::JsonConveter::FromJsonString(line, &item) && item.isObject()) FromJson(item, &info);
+            if (info.url_.empty() || info.storage_path_.empty()) {
+                wwlog::GetLogger("asynclogger")->Warn("skip bad journal record: %s", line.c_str());
+                return false;
+            }
             Insert(info);
-        }
+            return true;
+        }, durability_ != kDurabilityNone);
+        wwlog::GetLogger("asynclogger")->Info("journal replayed records: %u", replayed);
         return true;
     }
     bool Storage()
     {
+        MetricTimer timer(kStageSnapshot);
         wwlog::GetLogger("asynclogger")->Info("message storage start.");
         std::vector<StorageInfo> arr;
         if (!GetAll(&arr)) {
@@ -85,91 +115,137 @@ public:
             return false;
         }
 
-        Json::Value root;
+        if (storage_format_ == "binary") {
+            IndexWriter writer;
+            writer.Reserve(arr.size());
+            for (auto &e : arr) writer.Add(e.mtime_, e.atime_, e.fsize_, e.url_, e.storage_path_);
+            if (writer.Write(storage_file_, durability_ != kDurabilityNone) == false) {
+                wwlog::GetLogger("asynclogger")->Error("write binary StorageInfo Error");
+                return false;
+            }
+            wwlog::GetLogger("asynclogger")->Info("message storage end, entries: %u", arr.size());
+            return true;
+        }
+
+        Json::Value root(Json::arrayValue);
         for (auto &e : arr) {
             Json::Value item;
-            item["mtime_"] = (Json::Int64)e.mtime_;
-            item["atime_"] = (Json::Int64)e.atime_;
-            item["fsize_"] = (Json::Int64)e.fsize_;
-            item["url_"] = e.url_.c_str();
-            item["storage_path_"] = e.storage_path_.c_str();
+            ToJson(e, &item);
             root.append(item);
         }
 
         std::string body;
         JsonConveter::ToString(root, &body);
-        wwlog::GetLogger("asynclogger")->Info("new message for StorageInfo%s", body.c_str());
+        wwlog::GetLogger("asynclogger")->Info("new message for StorageInfo, entries: %u", arr.size());
 
-        File file(storage_file_);
-        if (file.SetContent(body.c_str(), body.size()) == false)
+        // 先写临时文件再 rename，避免写到一半崩溃时丢掉整个快照
+        std::string tmp_file = storage_file_ + ".tmp";
+        File file(tmp_file);
+        if (file.SetContent(body.c_str(), body.size()) == false) {
             wwlog::GetLogger("asynclogger")->Error("SetContent for StorageInfo Error");
+            return false;
+        }
+        if (durability_ != kDurabilityNone && file.Sync() == false) return false;
+        if (rename(tmp_file.c_str(), storage_file_.c_str()) == -1) {
+            wwlog::GetLogger("asynclogger")->Error("rename StorageInfo error: %s", strerror(errno));
+            return false;
+        }
 
         wwlog::GetLogger("asynclogger")->Info("message storage end.");
         return true;
     }
+    // 每次修改只生成一条日志记录交给 Persister，按 durability 策略写盘，
+    // 日志满 checkpoint_records_ 条时压缩成快照
+    bool Persist(const StorageInfo &info)
+    {
+        Json::Value item;
+        ToJson(info, &item);
+        std::string record;
+        JsonConveter::ToString(item, &record, true);
+        return persister_->Submit(info.url_, record);
+    }
     bool Insert(const StorageInfo &info)
     {
-        wwlog::GetLogger("asynclogger")->Info("data_message Insert start.");
-        pthread_rwlock_wrlock(&rwlock_);
-        table_[info.url_] = info;
-        pthread_rwlock_unlock(&rwlock_);
-        if (need_presist_ && Storage() == false) {
+        // 写表和提交日志在同一把锁内，保证日志顺序与内存中的修改顺序一致
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        table_->Put(info);
+        generation_++;
+        if (need_presist_ && Persist(info) == false) {
             wwlog::GetLogger("asynclogger")->Error("data_message Insert::Storage Error.");
             return false;
         }
-        wwlog::GetLogger("asynclogger")->Info("data_message Insert end.");
+        REQUEST_LOG("data_message Insert: %s", info.url_.c_str());
         return true;
     }
     bool Update(const StorageInfo &info)
     {
-        wwlog::GetLogger("asynclogger")->Info("data_message Update start.");
-        pthread_rwlock_wrlock(&rwlock_);
-        table_[info.url_] = info;
-        pthread_rwlock_unlock(&rwlock_);
-        if (Storage() == false) {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        table_->Put(info);
+        generation_++;
+        if (Persist(info) == false) {
             wwlog::GetLogger("asynclogger")->Error("data_message Update::Storage Error.");
             return false;
         }
-        wwlog::GetLogger("asynclogger")->Info("data_message Update end.");
+        REQUEST_LOG("data_message Update: %s", info.url_.c_str());
         return true;
     }
-    bool GetOneByURL(const std::string &key, StorageInfo *info)
+    // url 当前的条目仍是 expected（路径、大小、mtime 都没变）时才换成 info，返回是否替换。
+    // 给后台任务用：读取条目之后有新上传的话放弃，不会把旧内容写回索引。
+    // src 不为空时是事先写好的新文件，确认之后在锁里 rename 到 info 的存储路径，检查和落地之间不会插进别的写入
+    bool Replace(const StorageInfo &expected, const StorageInfo &info, const std::string &src = "")
     {
-        pthread_rwlock_rdlock(&rwlock_);
-        if (table_.find(key) == table_.end()) {
-            pthread_rwlock_unlock(&rwlock_);
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        StorageInfo current;
+        if (table_->GetByUrl(expected.url_, &current) == false || current.storage_path_ != expected.storage_path_ ||
+            current.fsize_ != expected.fsize_ || current.mtime_ != expected.mtime_) {
+            return false;
+        }
+        if (!src.empty() && rename(src.c_str(), info.storage_path_.c_str()) == -1) {
+            wwlog::GetLogger("asynclogger")
+                ->Error("rename %s to %s error: %s", src.c_str(), info.storage_path_.c_str(), strerror(errno));
+            return false;
+        }
+        table_->Put(info);
+        generation_++;
+        if (Persist(info) == false) {
+            wwlog::GetLogger("asynclogger")->Error("data_message Replace::Storage Error.");
             return false;
         }
-        *info = table_[key];
-        pthread_rwlock_unlock(&rwlock_);
         return true;
     }
+    bool GetOneByURL(const std::string &key, StorageInfo *info) { return table_->GetByUrl(key, info); }
     bool GetOneByStoragePath(const std::string &storage_path, StorageInfo *info)
     {
-        pthread_rwlock_rdlock(&rwlock_);
-        for (auto &e : table_) {
-            if (e.second.storage_path_ == storage_path) {
-                *info = e.second;
-                pthread_rwlock_unlock(&rwlock_);
-                return true;
-            }
-        }
-        pthread_rwlock_unlock(&rwlock_);
-        return false;
+        return table_->GetByStoragePath(storage_path, info);
     }
     bool GetAll(std::vector<StorageInfo> *array)
     {
-        pthread_rwlock_rdlock(&rwlock_);
-        for (auto &e : table_) array->emplace_back(e.second);
-        pthread_rwlock_unlock(&rwlock_);
+        table_->GetAll(array);
+        return true;
+    }
+    // 按有序索引输出，不需要每次请求再排序
+    bool GetAllSorted(SortOrder order, bool desc, std::vector<StorageInfo> *array)
+    {
+        table_->GetAllSorted(order, desc, array);
         return true;
     }
+    // 分页列出，返回后面是否还有
+    bool List(const ListQuery &query, std::vector<StorageTable::Entry> *page) { return table_->List(query, page); }
+    size_t Size() { return table_->Size(); }
+    // 每次修改索引加一，读到相同的值说明这期间索引没有变化，可以用来判断派生数据是否过期
+    uint64_t Generation() const { return generation_; }
 
 private:
     std::string storage_file_;
-    pthread_rwlock_t rwlock_;
-    std::unordered_map<std::string, StorageInfo> table_;
+    std::string storage_format_;
+    std::unique_ptr<Journal> journal_;
+    int checkpoint_records_;
+    std::unique_ptr<StorageTable> table_;
+    DurabilityPolicy durability_;
+    std::unique_ptr<Persister> persister_;
+    std::mutex write_mutex_;
     bool need_presist_;
+    std::atomic<uint64_t> generation_;
 };
 
 }  // namespace wwstorage
\ No newline at end of file
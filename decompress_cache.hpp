@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "utils.hpp"
+
+namespace wwstorage {
+
+// deep 文件解压结果的磁盘缓存：总大小不超过 capacity 字节，按 LRU 淘汰。
+// 传输中的条目有引用计数，只淘汰引用为 0 的条目；同一个 key 并发未命中时只解压一次，
+// 其他请求等待解压完成后直接复用
+class DecompressCache {
+public:
+    // 把解压结果写到 path，成功返回 true
+    typedef std::function<bool(const std::string &path)> Filler;
+
+    DecompressCache(const std::string &cache_dir, uint64_t capacity)
+        : cache_dir_(cache_dir), capacity_(capacity), used_(0), seq_(0), hits_(0), misses_(0)
+    {
+    }
+
+    // 缓存不跨进程保留，启动时清掉上次残留的文件
+    bool Init()
+    {
+        if (!File(cache_dir_).CreateDirectory()) return false;
+        // ScanDirectory 返回的是相对路径，cache_dir 是绝对路径时删不掉，这里直接用目录项的路径
+        for (auto &entry : std::filesystem::directory_iterator(cache_dir_)) {
+            if (entry.is_regular_file()) remove(entry.path().c_str());
+        }
+        return true;
+    }
+
+    // 取得 key 对应的解压文件并持有一个引用，未命中时调用 fill 生成；
+    // 放不进预算的文件只给这一次请求用，Release 时删除
+    bool Acquire(const std::string &key, uint64_t size, const Filler &fill, std::string *path)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            Entry &entry = it->second;
+            entry.refs++;
+            cv_.wait(lock, [&entry]() { return entry.ready || entry.failed; });
+            if (entry.failed) {
+                ReleaseLocked(key);
+                return false;
+            }
+            lru_.splice(lru_.begin(), lru_, entry.lru);
+            hits_++;
+            *path = entry.path;
+            return true;
+        }
+        misses_++;
+
+        std::string file = cache_dir_ + std::to_string(seq_++);
+        bool cached = size <= capacity_ && Reserve(size);
+        if (cached) {
+            Entry &entry = entries_[key];
+            entry.path = file;
+            entry.size = size;
+            entry.refs = 1;
+            entry.ready = false;
+            entry.failed = false;
+            lru_.push_front(key);
+            entry.lru = lru_.begin();
+            used_ += size;
+        }
+        lock.unlock();
+
+        bool ok = fill(file);
+        if (!cached) {
+            if (!ok) {
+                remove(file.c_str());
+                return false;
+            }
+            lock.lock();
+            transient_.insert(file);
+            *path = file;
+            return true;
+        }
+
+        lock.lock();
+        Entry &entry = entries_[key];
+        entry.ready = ok;
+        entry.failed = !ok;
+        cv_.notify_all();
+        if (!ok) {
+            ReleaseLocked(key);
+            return false;
+        }
+        *path = file;
+        return true;
+    }
+    // 传输结束后释放 Acquire 拿到的引用，key 和 path 与 Acquire 时一致
+    void Release(const std::string &key, const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = transient_.find(path);
+        if (it != transient_.end()) {
+            transient_.erase(it);
+            remove(path.c_str());
+            return;
+        }
+        ReleaseLocked(key);
+    }
+
+    uint64_t Hits() const { return hits_; }
+    uint64_t Misses() const { return misses_; }
+    uint64_t Used()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return used_;
+    }
+
+private:
+    struct Entry {
+        std::string path;
+        uint64_t size;
+        int refs;
+        bool ready;
+        bool failed;
+        std::list<std::string>::iterator lru;
+    };
+
+    void ReleaseLocked(const std::string &key)
+    {
+        auto it = entries_.find(key);
+        if (it == entries_.end()) return;
+        Entry &entry = it->second;
+        entry.refs--;
+        // 解压失败的条目在最后一个等待者离开后删除
+        if (entry.failed && entry.refs == 0) Erase(it);
+    }
+    // 从 LRU 尾部淘汰没有引用的条目，直到能放下 size 字节
+    bool Reserve(uint64_t size)
+    {
+        auto it = lru_.end();
+        while (used_ + size > capacity_ && it != lru_.begin()) {
+            --it;
+            auto entry = entries_.find(*it);
+            if (entry->second.refs > 0) continue;
+            wwlog::GetLogger("asynclogger")->Info("decompress cache evict: %s", it->c_str());
+            it = std::next(it);
+            Erase(entry);
+        }
+        return used_ + size <= capacity_;
+    }
+    void Erase(std::unordered_map<std::string, Entry>::iterator it)
+    {
+        remove(it->second.path.c_str());
+        used_ -= it->second.size;
+        lru_.erase(it->second.lru);
+        entries_.erase(it);
+    }
+
+private:
+    std::string cache_dir_;
+    uint64_t capacity_;
+
+    std::mutex mutex_;  // 保护以下所有成员
+    std::condition_variable cv_;
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_;  // 头部是最近使用的 key
+    std::unordered_set<std::string> transient_;  // 不进缓存、用完即删的文件
+    uint64_t used_;
+    uint64_t seq_;
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+};
+
+}  // namespace wwstorage
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "block_container.hpp"
+#include "chunk_store.hpp"
+
+namespace wwstorage {
+
+// 文件里的一段字节
+struct FileSegment {
+    std::string path;
+    uint64_t offset;
+    uint64_t length;
+};
+
+// deep_storage 文件的统一读写入口。设置了块仓库时写成内容定义分块的清单，
+// 否则 block_size 为 0 时按旧格式整体 bundle::pack，不为 0 时写分块容器。
+// 读取时按文件头自动识别三种格式。threads 是并行压缩/解压用的线程数。
+// encoding 为 gzip/zstd 时块按 HTTP 能直接解码的格式封装（旧的整体格式不支持，忽略），
+// 客户端接受这种编码时可以不解压直接发送。zstd 的多个 frame 可以直接拼接；
+// 而浏览器和 curl 只解第一个 gzip member，所以 gzip 文件整个作为一个块写成单个 member，不分块也不去重，
+// 压缩时整个文件都在内存里，调用方要限制 gzip 文件的大小
+class DeepFile {
+public:
+    DeepFile() : block_(false), chunk_(false) {}
+
+    // 启动时设置一次，之后只读
+    static void SetChunkStore(ChunkStore *store) { chunk_store_ = store; }
+    // 用这种编码写的文件是否进块仓库
+    static bool Chunked(ContentEncoding encoding) { return chunk_store_ && encoding != kEncodingGzip; }
+
+    static bool Write(const std::string &dst, const std::string &content, int format, size_t block_size,
+                      int threads = 1, ContentEncoding encoding = kEncodingBundle)
+    {
+        if (encoding == kEncodingGzip) block_size = std::max<size_t>(content.size(), 1);
+        if (Chunked(encoding)) {
+            ChunkWriter writer(chunk_store_, dst, format, threads, encoding);
+            return writer.Open() && writer.Write(content.data(), content.size()) && writer.Finish();
+        }
+        if (block_size == 0) return File(dst).Compress(content, format);
+        BlockWriter writer(dst, format, block_size, threads, encoding);
+        return writer.Open() && writer.Write(content.data(), content.size()) && writer.Finish();
+    }
+    static bool WriteFile(const std::string &dst, const std::string &src, int format, size_t block_size,
+                          int threads = 1, ContentEncoding encoding = kEncodingBundle)
+    {
+        if (encoding == kEncodingGzip) block_size = std::max<int64_t>(File(src).Size(), 1);
+        if (Chunked(encoding)) {
+            return ChunkWriter::ChunkFile(chunk_store_, src, dst, format, threads, encoding);
+        }
+        if (block_size > 0) return BlockWriter::CompressFile(src, dst, format, block_size, threads, encoding);
+        std::string content;
+        return File(src).GetContent(&content) && File(dst).Compress(content, format);
+    }
+
+    bool Open(const std::string &file_name)
+    {
+        file_name_ = file_name;
+        block_ = BlockReader::IsBlockFile(file_name);
+        if (block_) return reader_.Open(file_name);
+        chunk_ = ChunkReader::IsChunkFile(file_name);
+        if (chunk_) {
+            if (chunk_store_ == nullptr) {
+                wwlog::GetLogger("asynclogger")->Error("%s needs the chunk store.", file_name.c_str());
+                return false;
+            }
+            return chunk_reader_.Open(chunk_store_, file_name);
+        }
+        return File(file_name).Exists();
+    }
+    void SetThreads(int threads)
+    {
+        reader_.SetThreads(threads);
+        chunk_reader_.SetThreads(threads);
+    }
+    bool IsBlockFile() const { return block_; }
+    bool IsChunkFile() const { return chunk_; }
+    // 块清单和块不太大的分块容器可以只解压覆盖到的部分
+    bool RandomAccess() const { return chunk_ || (block_ && reader_.BlockSize() <= kMaxRandomAccessBlock); }
+    ContentEncoding Encoding() const
+    {
+        if (block_) return reader_.Encoding();
+        if (chunk_) return chunk_reader_.Encoding();
+        return kEncodingBundle;
+    }
+    // Encoding() 不是 bundle 时，按顺序发送这些文件段就是编码后的完整内容
+    void EncodedSegments(std::vector<FileSegment> *segments)
+    {
+        segments->clear();
+        if (block_ && reader_.BodyLength() > 0) {
+            segments->push_back({file_name_, reader_.BodyOffset(), reader_.BodyLength()});
+        }
+        for (size_t i = 0; chunk_ && i < chunk_reader_.ChunkCount(); i++) {
+            std::string path = chunk_reader_.ChunkPath(i);
+            segments->push_back({path, 0, (uint64_t)File(path).Size()});
+        }
+    }
+    // 原始数据大小，旧格式从 bundle 头部读取，不需要解压
+    uint64_t RawSize()
+    {
+        if (block_) return reader_.RawSize();
+        if (chunk_) return chunk_reader_.RawSize();
+        std::string head;
+        File file(file_name_);
+        int64_t size = file.Size();
+        if (size <= 0 || !file.GetPosLen(&head, 0, std::min<int64_t>(size, bundle::MAX_HEADER_SIZE + 32))) return 0;
+        if (!bundle::is_packed(head)) return size;
+        return bundle::len(head.data(), head.size());
+    }
+    bool ReadRange(uint64_t pos, uint64_t len, std::string *content)
+    {
+        if (block_) return reader_.ReadRange(pos, len, content);
+        if (chunk_) return chunk_reader_.ReadRange(pos, len, content);
+        // 旧格式只能整体解压后截取
+        std::string packed;
+        if (!File(file_name_).GetContent(&packed)) return false;
+        std::string unpacked = bundle::unpack(packed);
+        if (pos + len > unpacked.size()) return false;
+        content->assign(unpacked, pos, len);
+        return true;
+    }
+    bool DecodeTo(const std::string &dst)
+    {
+        if (block_) return reader_.DecodeTo(dst);
+        if (chunk_) return chunk_reader_.DecodeTo(dst);
+        std::string download_path = dst;
+        return File(file_name_).UnCompress(download_path);
+    }
+
+private:
+    static const uint64_t kMaxRandomAccessBlock = 16 * 1024 * 1024;
+
+    std::string file_name_;
+    bool block_;
+    bool chunk_;
+    BlockReader reader_;
+    ChunkReader chunk_reader_;
+
+    static ChunkStore *chunk_store_;
+};
+
+ChunkStore *DeepFile::chunk_store_ = nullptr;
+
+}  // namespace wwstorage
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <event2/buffer.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "utils.hpp"
+
+namespace wwstorage {
+
+// 热文件的 fd 和大小缓存：每个条目持有一个 evbuffer_file_segment，下载时直接把段挂到响应上，
+// 命中时不再 stat/open。段由 libevent 引用计数，条目被淘汰或失效后，正在发送的响应仍持有引用，
+// 发完才关闭 fd。最多缓存 capacity 个文件，按 LRU 淘汰。
+// 文件被上传覆盖时由调用方 Invalidate；开启 inotify 时外部对存储目录的修改也会让条目失效
+class FileCache {
+public:
+    explicit FileCache(size_t capacity)
+        : capacity_(capacity), inotify_fd_(-1), seq_(0), hits_(0), misses_(0), evictions_(0), invalidations_(0)
+    {
+    }
+
+    // watch_dirs 为空表示不用 inotify
+    bool Init(const std::vector<std::string> &watch_dirs)
+    {
+        if (watch_dirs.empty()) return true;
+        inotify_fd_ = inotify_init1(IN_CLOEXEC);
+        if (inotify_fd_ == -1) {
+            wwlog::GetLogger("asynclogger")->Error("inotify_init1 error: %s", strerror(errno));
+            return false;
+        }
+        const uint32_t kMask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE;
+        for (auto &dir : watch_dirs) {
+            File(dir).CreateDirectory();
+            int wd = inotify_add_watch(inotify_fd_, dir.c_str(), kMask);
+            if (wd == -1) {
+                wwlog::GetLogger("asynclogger")->Error("inotify_add_watch %s error: %s", dir.c_str(), strerror(errno));
+                return false;
+            }
+            watches_[wd] = dir.back() == '/' ? dir : dir + "/";
+        }
+        watcher_ = std::thread(&FileCache::Watch, this);
+        watcher_.detach();
+        return true;
+    }
+
+    // 文件大小，命中时没有系统调用
+    bool Stat(const std::string &path, uint64_t *size)
+    {
+        return With(path, [size](Entry &entry) {
+            *size = entry.size;
+            return true;
+        });
+    }
+    // 把文件的 [offset, offset+length) 挂到 outbuf，发送时走 sendfile
+    bool AddRange(evbuffer *outbuf, const std::string &path, uint64_t offset, uint64_t length)
+    {
+        return With(path, [&](Entry &entry) {
+            if (offset + length > entry.size) {
+                wwlog::GetLogger("asynclogger")
+                    ->Error("range out of file: %s %llu+%llu > %llu", path.c_str(), (unsigned long long)offset,
+                            (unsigned long long)length, (unsigned long long)entry.size);
+                return false;
+            }
+            return evbuffer_add_file_segment(outbuf, entry.segment, offset, length) == 0;
+        });
+    }
+    // path 的内容变了（上传覆盖、删除、迁移），下次访问重新打开
+    void Invalidate(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        seq_++;
+        auto it = entries_.find(path);
+        if (it == entries_.end()) return;
+        invalidations_++;
+        Erase(it);
+    }
+
+    uint64_t Hits() const { return hits_; }
+    uint64_t Misses() const { return misses_; }
+    uint64_t Evictions() const { return evictions_; }
+    uint64_t Invalidations() const { return invalidations_; }
+    size_t Size()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+private:
+    struct Entry {
+        evbuffer_file_segment *segment;  // 缓存持有的一个引用
+        uint64_t size;
+        std::list<std::string>::iterator lru;
+    };
+
+    // 在持有 mutex_ 的情况下对 path 的条目执行 fn，保证段在 fn 里不会被别的线程释放。
+    // 未命中时在锁外打开文件；打开期间有过 Invalidate 的话，打开的可能是旧文件，只给这一次用
+    template <class Fn>
+    bool With(const std::string &path, const Fn &fn)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto it = entries_.find(path);
+        if (it != entries_.end()) {
+            hits_++;
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+            return fn(it->second);
+        }
+        misses_++;
+        uint64_t seq = seq_;
+        lock.unlock();
+        Report();
+
+        Entry entry;
+        if (Open(path, &entry) == false) return false;
+        lock.lock();
+        if (seq != seq_ || capacity_ == 0 || entries_.count(path) > 0) {
+            lock.unlock();
+            bool ok = fn(entry);
+            evbuffer_file_segment_free(entry.segment);
+            return ok;
+        }
+        while (entries_.size() >= capacity_) {
+            evictions_++;
+            Erase(entries_.find(lru_.back()));
+        }
+        lru_.push_front(path);
+        entry.lru = lru_.begin();
+        return fn(entries_.emplace(path, entry).first->second);
+    }
+    static bool Open(const std::string &path, Entry *entry)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            wwlog::GetLogger("asynclogger")->Info("open file error: %s -- %s", path.c_str(), strerror(errno));
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == -1 ||
+            (entry->segment = evbuffer_file_segment_new(fd, 0, st.st_size, EVBUF_FS_CLOSE_ON_FREE)) == nullptr) {
+            wwlog::GetLogger("asynclogger")->Error("file segment error: %s -- %s", path.c_str(), strerror(errno));
+            close(fd);
+            return false;
+        }
+        entry->size = st.st_size;
+        return true;
+    }
+    // 调用方持有 mutex_
+    void Erase(std::unordered_map<std::string, Entry>::iterator it)
+    {
+        evbuffer_file_segment_free(it->second.segment);
+        lru_.erase(it->second.lru);
+        entries_.erase(it);
+    }
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        seq_++;
+        while (!entries_.empty()) Erase(entries_.begin());
+    }
+    // 每 4096 次未命中打一行命中率
+    void Report()
+    {
+        uint64_t misses = misses_;
+        if (misses % 4096 != 0) return;
+        uint64_t hits = hits_;
+        wwlog::GetLogger("asynclogger")
+            ->Info("file cache hits:%llu misses:%llu hit rate:%.4f evictions:%llu invalidations:%llu",
+                   (unsigned long long)hits, (unsigned long long)misses, (double)hits / (hits + misses),
+                   (unsigned long long)evictions_, (unsigned long long)invalidations_);
+    }
+    // inotify 线程：存储目录里的文件被改写、替换、删除时让对应条目失效，事件队列溢出时全部清掉
+    void Watch()
+    {
+        alignas(struct inotify_event) char buf[64 * 1024];
+        while (true) {
+            ssize_t n = read(inotify_fd_, buf, sizeof(buf));
+            if (n <= 0) {
+                if (n == -1 && errno == EINTR) continue;
+                wwlog::GetLogger("asynclogger")->Error("inotify read error: %s", strerror(errno));
+                return;
+            }
+            for (char *p = buf; p < buf + n;) {
+                auto event = (struct inotify_event *)p;
+                p += sizeof(struct inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    wwlog::GetLogger("asynclogger")->Warn("inotify queue overflow, clear file cache.");
+                    Clear();
+                    continue;
+                }
+                auto dir = watches_.find(event->wd);
+                if (dir == watches_.end() || event->len == 0) continue;
+                Invalidate(dir->second + event->name);
+            }
+        }
+    }
+
+private:
+    size_t capacity_;
+    int inotify_fd_;
+    std::unordered_map<int, std::string> watches_;  // Init 之后只读
+    std::thread watcher_;
+
+    std::mutex mutex_;  // 保护以下所有成员
+    std::unordered_map<std::string, Entry> entries_;
+    std::list<std::string> lru_;  // 头部是最近使用的 path
+    uint64_t seq_;  // Invalidate 的次数，用来发现打开文件期间的失效
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> misses_;
+    std::atomic<uint64_t> evictions_;
+    std::atomic<uint64_t> invalidations_;
+};
+
+}  // namespace wwstorage
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace wwstorage {
+
+// 闭区间 [start, start + length - 1]
+struct ByteRange {
+    uint64_t start;
+    uint64_t length;
+};
+
+// ignore: 没有 Range 或语法不合法，按 RFC 7233 忽略，返回完整文件
+// satisfiable: 至少有一个区间落在文件内
+// unsatisfiable: 所有区间都超出文件大小，应回复 416
+enum RangeResult { kRangeIgnore, kRangeSatisfiable, kRangeUnsatisfiable };
+
+// 单个请求里区间太多时整体忽略，避免被用来放大响应
+const size_t kMaxRanges = 16;
+
+static bool ParseRangeNumber(const std::string &text, uint64_t *value)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+    *value = strtoull(text.c_str(), nullptr, 10);
+    return true;
+}
+
+static std::string TrimRangeSpec(const std::string &text)
+{
+    size_t begin = text.find_first_not_of(" \t");
+    if (begin == std::string::npos) return "";
+    size_t end = text.find_last_not_of(" \t");
+    return text.substr(begin, end - begin + 1);
+}
+
+// 解析 "bytes=a-b, a-, -n"，只保留和 [0, size) 有交集的区间
+static RangeResult ParseRange(const std::string &header, uint64_t size, std::vector<ByteRange> *ranges)
+{
+    ranges->clear();
+    const std::string unit = "bytes=";
+    if (header.compare(0, unit.size(), unit) != 0) return kRangeIgnore;
+
+    std::vector<std::string> specs;
+    size_t start = unit.size(), end;
+    do {
+        end = header.find(',', start);
+        std::string spec = TrimRangeSpec(header.substr(start, end == std::string::npos ? end : end - start));
+        if (!spec.empty()) specs.push_back(spec);
+        start = end + 1;
+    } while (end != std::string::npos);
+    if (specs.empty() || specs.size() > kMaxRanges) return kRangeIgnore;
+
+    for (auto &spec : specs) {
+        size_t dash = spec.find('-');
+        if (dash == std::string::npos) return kRangeIgnore;
+        std::string first = spec.substr(0, dash), last = spec.substr(dash + 1);
+        uint64_t a = 0, b = 0;
+        if (first.empty()) {
+            // 后缀区间：最后 n 个字节
+            if (!ParseRangeNumber(last, &b)) return kRangeIgnore;
+            if (b == 0 || size == 0) continue;
+            b = std::min(b, size);
+            ranges->push_back({size - b, b});
+            continue;
+        }
+        if (!ParseRangeNumber(first, &a)) return kRangeIgnore;
+        if (last.empty()) {
+            b = UINT64_MAX;
+        } else if (!ParseRangeNumber(last, &b) || b < a) {
+            return kRangeIgnore;
+        }
+        if (a >= size) continue;
+        b = std::min(b, size - 1);
+        ranges->push_back({a, b - a + 1});
+    }
+    return ranges->empty() ? kRangeUnsatisfiable : kRangeSatisfiable;
+}
+
+static std::string ContentRange(const ByteRange &range, uint64_t size)
+{
+    return "bytes " + std::to_string(range.start) + "-" + std::to_string(range.start + range.length - 1) + "/" +
+           std::to_string(size);
+}
+
+}  // namespace wwstorage
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace wwstorage {
+
+// storage.data 的二进制格式（小端，可直接 mmap）：
+//   IndexHeader | IndexRecord * count | 字符串堆 heap_size 字节
+// 记录定长，url/storage_path 以 (偏移, 长度) 引用字符串堆，
+// checksum 是记录区和字符串堆的 FNV-1a 64
+const char kIndexMagic[4] = {'F', 'R', 'I', 'X'};
+const uint32_t kIndexVersion = 1;
+
+struct IndexHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+    uint64_t heap_size;
+    uint64_t checksum;
+};
+
+struct IndexRecord {
+    int64_t mtime;
+    int64_t atime;
+    uint64_t fsize;
+    uint64_t url_off;
+    uint64_t path_off;
+    uint32_t url_len;
+    uint32_t path_len;
+};
+
+static_assert(sizeof(IndexHeader) == 32, "IndexHeader layout changed");
+static_assert(sizeof(IndexRecord) == 48, "IndexRecord layout changed");
+
+struct IndexEntry {
+    int64_t mtime;
+    int64_t atime;
+    uint64_t fsize;
+    std::string_view url;
+    std::string_view storage_path;
+};
+
+static uint64_t IndexChecksum(const char *data, size_t len, uint64_t hash = 14695981039346656037ULL)
+{
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+class IndexWriter {
+public:
+    void Reserve(size_t count) { records_.reserve(count); }
+    void Add(int64_t mtime, int64_t atime, uint64_t fsize, const std::string &url, const std::string &storage_path)
+    {
+        IndexRecord record;
+        record.mtime = mtime;
+        record.atime = atime;
+        record.fsize = fsize;
+        record.url_off = heap_.size();
+        record.url_len = url.size();
+        heap_ += url;
+        record.path_off = heap_.size();
+        record.path_len = storage_path.size();
+        heap_ += storage_path;
+        records_.push_back(record);
+    }
+    // 写临时文件后 rename，保证 storage.data 始终是完整的；sync 为真时 rename 前先落盘
+    bool Write(const std::string &index_file, bool sync = false)
+    {
+        IndexHeader header;
+        memcpy(header.magic, kIndexMagic, sizeof(header.magic));
+        header.version = kIndexVersion;
+        header.count = records_.size();
+        header.heap_size = heap_.size();
+        header.checksum = IndexChecksum((const char *)records_.data(), records_.size() * sizeof(IndexRecord));
+        header.checksum = IndexChecksum(heap_.data(), heap_.size(), header.checksum);
+
+        std::string tmp_file = index_file + ".tmp";
+        std::ofstream ofs(tmp_file, std::ios::binary | std::ios::trunc);
+        if (ofs.is_open() == false) {
+            wwlog::GetLogger("asynclogger")->Error("%s, index file open error.", tmp_file.c_str());
+            return false;
+        }
+        ofs.write((const char *)&header, sizeof(header));
+        ofs.write((const char *)records_.data(), records_.size() * sizeof(IndexRecord));
+        ofs.write(heap_.data(), heap_.size());
+        ofs.close();
+        if (!ofs.good()) {
+            wwlog::GetLogger("asynclogger")->Error("%s, index file write error.", tmp_file.c_str());
+            return false;
+        }
+        if (sync && File(tmp_file).Sync() == false) return false;
+        if (rename(tmp_file.c_str(), index_file.c_str()) == -1) {
+            wwlog::GetLogger("asynclogger")->Error("rename index file error: %s", strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::vector<IndexRecord> records_;
+    std::string heap_;
+};
+
+// 只读映射 storage.data，打开时校验头部、边界和 checksum，之后按下标零拷贝读取
+class IndexMap {
+public:
+    IndexMap() : base_(nullptr), size_(0), records_(nullptr), heap_(nullptr), count_(0) {}
+    ~IndexMap() { Close(); }
+    IndexMap(const IndexMap &) = delete;
+    IndexMap &operator=(const IndexMap &) = delete;
+
+    static bool IsIndexFile(const std::string &index_file)
+    {
+        char magic[sizeof(kIndexMagic)] = {0};
+        std::ifstream ifs(index_file, std::ios::binary);
+        ifs.read(magic, sizeof(magic));
+        return ifs.good() && memcmp(magic, kIndexMagic, sizeof(magic)) == 0;
+    }
+    bool Open(const std::string &index_file)
+    {
+        int fd = open(index_file.c_str(), O_RDONLY);
+        if (fd == -1) {
+            wwlog::GetLogger("asynclogger")->Error("%s, index open error: %s", index_file.c_str(), strerror(errno));
+            return false;
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) == -1 || (size_t)file_stat.st_size < sizeof(IndexHeader)) {
+            wwlog::GetLogger("asynclogger")->Error("%s, index file truncated.", index_file.c_str());
+            close(fd);
+            return false;
+        }
+        size_ = file_stat.st_size;
+        base_ = (const char *)mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (base_ == MAP_FAILED) {
+            wwlog::GetLogger("asynclogger")->Error("%s, index mmap error: %s", index_file.c_str(), strerror(errno));
+            base_ = nullptr;
+            return false;
+        }
+        madvise((void *)base_, size_, MADV_SEQUENTIAL);
+        if (Validate() == false) {
+            wwlog::GetLogger("asynclogger")->Error("%s, index file corrupted.", index_file.c_str());
+            Close();
+            return false;
+        }
+        return true;
+    }
+    void Close()
+    {
+        if (base_ != nullptr) munmap((void *)base_, size_);
+        base_ = nullptr;
+        size_ = 0;
+        count_ = 0;
+    }
+    size_t Size() const { return count_; }
+    IndexEntry Get(size_t i) const
+    {
+        const IndexRecord &record = records_[i];
+        IndexEntry entry;
+        entry.mtime = record.mtime;
+        entry.atime = record.atime;
+        entry.fsize = record.fsize;
+        entry.url = std::string_view(heap_ + record.url_off, record.url_len);
+        entry.storage_path = std::string_view(heap_ + record.path_off, record.path_len);
+        return entry;
+    }
+
+private:
+    bool Validate()
+    {
+        const IndexHeader *header = (const IndexHeader *)base_;
+        if (memcmp(header->magic, kIndexMagic, sizeof(kIndexMagic)) != 0) return false;
+        if (header->version != kIndexVersion) {
+            wwlog::GetLogger("asynclogger")->Error("unsupported index version: %u", header->version);
+            return false;
+        }
+        size_t body = size_ - sizeof(IndexHeader);
+        if (header->count > body / sizeof(IndexRecord)) return false;
+        if (header->heap_size != body - header->count * sizeof(IndexRecord)) return false;
+
+        records_ = (const IndexRecord *)(base_ + sizeof(IndexHeader));
+        heap_ = base_ + sizeof(IndexHeader) + header->count * sizeof(IndexRecord);
+        count_ = header->count;
+        for (size_t i = 0; i < count_; i++) {
+            // 先比 off 再用减法比 len，损坏的文件里 off + len 可能溢出回绕
+            const IndexRecord &record = records_[i];
+            if (record.url_off > header->heap_size || record.url_len > header->heap_size - record.url_off) return false;
+            if (record.path_off > header->heap_size || record.path_len > header->heap_size - record.path_off) {
+                return false;
+            }
+        }
+        return IndexChecksum(base_ + sizeof(IndexHeader), body) == header->checksum;
+    }
+
+private:
+    const char *base_;
+    size_t size_;
+    const IndexRecord *records_;
+    const char *heap_;
+    size_t count_;
+};
+
+}  // namespace wwstorage
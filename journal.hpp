@@ -0,0 +1,136 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace wwstorage {
+
+// 追加写日志：每条记录一行，只有以 '\n' 结尾的行才算完整记录，
+// 崩溃时写了一半的尾部记录在回放时会被丢弃
+class Journal {
+public:
+    Journal(const std::string &journal_file) : journal_file_(journal_file), fd_(-1), records_(0) {}
+    ~Journal() { Close(); }
+
+    bool Open()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fd_ = open(journal_file_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd_ == -1) {
+            wwlog::GetLogger("asynclogger")
+                ->Error("%s, journal open error: %s", journal_file_.c_str(), strerror(errno));
+            return false;
+        }
+        return true;
+    }
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ != -1) close(fd_);
+        fd_ = -1;
+    }
+    // 回放所有完整记录，apply 返回 false 的记录不计数，返回回放的记录数。
+    // 残缺的尾部会被截掉，sync 为 true 时截断后落盘
+    size_t Replay(const std::function<bool(const std::string &)> &apply, bool sync)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        File file(journal_file_);
+        std::string body;
+        if (!file.Exists() || !file.GetContent(&body)) return 0;
+
+        size_t count = 0, start = 0, end;
+        while ((end = body.find('\n', start)) != std::string::npos) {
+            if (end > start && apply(body.substr(start, end - start))) ++count;
+            start = end + 1;
+        }
+        if (start < body.size()) {
+            wwlog::GetLogger("asynclogger")
+                ->Warn("%s, drop torn journal tail: %u bytes", journal_file_.c_str(), body.size() - start);
+            // 不截掉的话，之后以 O_APPEND 追加的第一条记录会接在残片后面，下次回放时连同它一起丢掉
+            if (truncate(journal_file_.c_str(), start) == -1 || (sync && !SyncFile())) {
+                wwlog::GetLogger("asynclogger")
+                    ->Error("%s, journal truncate error: %s", journal_file_.c_str(), strerror(errno));
+            }
+        }
+        records_ = count;
+        return count;
+    }
+    bool Append(const std::string &record) { return Append(std::vector<std::string>{record}); }
+    // 一批记录合并成一次 write
+    bool Append(const std::vector<std::string> &records)
+    {
+        std::string lines;
+        for (auto &record : records) lines += record + "\n";
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ == -1) return false;
+        size_t written = 0;
+        while (written < lines.size()) {
+            ssize_t ret = write(fd_, lines.c_str() + written, lines.size() - written);
+            if (ret == -1) {
+                if (errno == EINTR) continue;
+                wwlog::GetLogger("asynclogger")
+                    ->Error("%s, journal append error: %s", journal_file_.c_str(), strerror(errno));
+                return false;
+            }
+            written += ret;
+        }
+        records_ += records.size();
+        return true;
+    }
+    bool Sync()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ == -1) return false;
+        if (fdatasync(fd_) == -1) {
+            wwlog::GetLogger("asynclogger")
+                ->Error("%s, journal sync error: %s", journal_file_.c_str(), strerror(errno));
+            return false;
+        }
+        return true;
+    }
+    // 检查点：持有日志锁写快照，快照成功后截断日志。
+    // 期间的 Append 会被阻塞，所以截断不会丢掉快照之后的记录
+    bool Checkpoint(const std::function<bool()> &snapshot)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!snapshot()) return false;
+        if (fd_ != -1 && ftruncate(fd_, 0) == -1) {
+            wwlog::GetLogger("asynclogger")
+                ->Error("%s, journal truncate error: %s", journal_file_.c_str(), strerror(errno));
+            return false;
+        }
+        records_ = 0;
+        return true;
+    }
+    size_t Records()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return records_;
+    }
+
+private:
+    // 调用方持有 mutex_
+    bool SyncFile()
+    {
+        int fd = open(journal_file_.c_str(), O_WRONLY);
+        if (fd == -1) return false;
+        bool ok = fsync(fd) == 0;
+        close(fd);
+        return ok;
+    }
+
+private:
+    std::string journal_file_;
+    int fd_;
+    size_t records_;
+    std::mutex mutex_;
+};
+
+}  // namespace wwstorage
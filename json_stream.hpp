@@ -0,0 +1,137 @@
+#pragma once
+
+#include <event2/buffer.h>
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wwstorage {
+
+// 直接把 JSON 追加到 evbuffer，不经过 Json::Value 树，内存只和嵌套深度有关。
+// 调用方负责按正确的顺序调用：对象里先 Key 再写值
+class JsonStream {
+public:
+    explicit JsonStream(evbuffer *out) : out_(out), after_key_(false) {}
+
+    JsonStream &BeginObject() { return Open('{'); }
+    JsonStream &EndObject() { return Close('}'); }
+    JsonStream &BeginArray() { return Open('['); }
+    JsonStream &EndArray() { return Close(']'); }
+    JsonStream &Key(const std::string &key)
+    {
+        Separate();
+        Quote(key);
+        evbuffer_add(out_, ":", 1);
+        after_key_ = true;
+        return *this;
+    }
+    JsonStream &String(const std::string &value)
+    {
+        Separate();
+        Quote(value);
+        return *this;
+    }
+    JsonStream &Int(int64_t value)
+    {
+        Separate();
+        evbuffer_add_printf(out_, "%lld", (long long)value);
+        return *this;
+    }
+    JsonStream &Uint(uint64_t value)
+    {
+        Separate();
+        evbuffer_add_printf(out_, "%llu", (unsigned long long)value);
+        return *this;
+    }
+    // NaN 和无穷大不是合法的 JSON，写成 null
+    JsonStream &Double(double value)
+    {
+        if (!std::isfinite(value)) return Null();
+        Separate();
+        evbuffer_add_printf(out_, "%.6g", value);
+        return *this;
+    }
+    JsonStream &Bool(bool value)
+    {
+        Separate();
+        evbuffer_add(out_, value ? "true" : "false", value ? 4 : 5);
+        return *this;
+    }
+    JsonStream &Null()
+    {
+        Separate();
+        evbuffer_add(out_, "null", 4);
+        return *this;
+    }
+
+private:
+    JsonStream &Open(char c)
+    {
+        Separate();
+        evbuffer_add(out_, &c, 1);
+        first_.push_back(true);
+        return *this;
+    }
+    JsonStream &Close(char c)
+    {
+        first_.pop_back();
+        evbuffer_add(out_, &c, 1);
+        return *this;
+    }
+    // 同一层里除了第一个元素，前面都要加逗号；紧跟在 Key 后面的值不加
+    void Separate()
+    {
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+        if (first_.empty()) return;
+        if (!first_.back()) evbuffer_add(out_, ",", 1);
+        first_.back() = false;
+    }
+    void Quote(const std::string &s)
+    {
+        static const char *hex = "0123456789abcdef";
+        std::string escaped;
+        escaped.reserve(s.size() + 2);
+        escaped += '"';
+        for (unsigned char c : s) {
+            switch (c) {
+                case '"':
+                    escaped += "\\\"";
+                    break;
+                case '\\':
+                    escaped += "\\\\";
+                    break;
+                case '\n':
+                    escaped += "\\n";
+                    break;
+                case '\r':
+                    escaped += "\\r";
+                    break;
+                case '\t':
+                    escaped += "\\t";
+                    break;
+                default:
+                    if (c < 0x20) {
+                        escaped += "\\u00";
+                        escaped += hex[c >> 4];
+                        escaped += hex[c & 0xf];
+                    } else {
+                        escaped += (char)c;
+                    }
+            }
+        }
+        escaped += '"';
+        evbuffer_add(out_, escaped.data(), escaped.size());
+    }
+
+private:
+    evbuffer *out_;
+    std::vector<bool> first_;  // 每层是否还没写过元素
+    bool after_key_;
+};
+
+}  // namespace wwstorage
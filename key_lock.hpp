@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace wwstorage {
+
+// 按字符串 key 互斥：同一个 key 同时只有一个持有者，不同 key 互不等待。
+// 只记录正在被持有或有人等待的 key，最后一个使用者离开时删掉
+class KeyLock {
+public:
+    class Guard {
+    public:
+        Guard(KeyLock &locks, const std::string &key) : locks_(locks), key_(key) { locks_.Lock(key_); }
+        ~Guard() { locks_.Unlock(key_); }
+        Guard(const Guard &) = delete;
+        Guard &operator=(const Guard &) = delete;
+
+    private:
+        KeyLock &locks_;
+        std::string key_;
+    };
+
+    void Lock(const std::string &key)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        State &state = keys_[key];  // unordered_map 插入不会让已有元素的引用失效
+        state.waiting++;
+        cv_.wait(lock, [&state]() { return !state.held; });
+        state.waiting--;
+        state.held = true;
+    }
+    void Unlock(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = keys_.find(key);
+        if (it == keys_.end()) return;
+        it->second.held = false;
+        if (it->second.waiting == 0) {
+            keys_.erase(it);
+            return;
+        }
+        cv_.notify_all();
+    }
+
+private:
+    struct State {
+        State() : held(false), waiting(0) {}
+        bool held;
+        int waiting;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unordered_map<std::string, State> keys_;
+};
+
+}  // namespace wwstorage
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <sys/stat.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "utils.hpp"
+
+namespace wwstorage {
+
+// 首页模板和文件列表的缓存。模板加载时就按列表占位符切开，其余占位符直接替换成常量，
+// 模板文件的 mtime/大小变化时重新加载；列表片段按 DataManager 的修改代数缓存，
+// 索引没变就不重新生成。返回的片段都是不可变的 shared_ptr，可以直接 evbuffer_add_reference
+class ListPage {
+public:
+    typedef std::shared_ptr<const std::string> Piece;
+    typedef std::function<std::string()> Renderer;
+
+    // slot 是文件列表的占位符，constants 里的占位符在加载模板时一次替换掉
+    ListPage(const std::string &template_path, const std::string &slot,
+             const std::map<std::string, std::string> &constants)
+        : template_path_(template_path), slot_(slot), constants_(constants), mtime_ns_(-1), size_(-1),
+          generation_(0), rendered_(false)
+    {
+    }
+
+    // 按顺序拼起来就是整个页面；generation 和上次不同时调用 render 重新生成列表
+    bool Get(uint64_t generation, const Renderer &render, std::vector<Piece> *pieces)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!LoadTemplate()) return false;
+        if (!rendered_ || generation != generation_) {
+            list_ = std::make_shared<const std::string>(render());
+            generation_ = generation;
+            rendered_ = true;
+            wwlog::GetLogger("asynclogger")->Info("file list rendered, generation: %llu, %u bytes",
+                                                  (unsigned long long)generation, list_->size());
+        }
+        pieces->clear();
+        for (size_t i = 0; i < segments_.size(); i++) {
+            if (i > 0) pieces->push_back(list_);
+            pieces->push_back(segments_[i]);
+        }
+        return true;
+    }
+
+private:
+    // 调用方持有 mutex_
+    bool LoadTemplate()
+    {
+        struct stat st;
+        if (stat(template_path_.c_str(), &st) == -1) {
+            wwlog::GetLogger("asynclogger")->Error("template %s stat error: %s", template_path_.c_str(), strerror(errno));
+            return !segments_.empty();
+        }
+        int64_t mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        if (mtime_ns == mtime_ns_ && st.st_size == size_) return true;
+
+        std::string content;
+        if (!File(template_path_).GetContent(&content)) return !segments_.empty();
+        for (auto &constant : constants_) {
+            for (size_t pos = 0; (pos = content.find(constant.first, pos)) != std::string::npos;) {
+                content.replace(pos, constant.first.size(), constant.second);
+                pos += constant.second.size();
+            }
+        }
+        std::vector<Piece> segments;
+        size_t start = 0;
+        for (size_t pos; (pos = content.find(slot_, start)) != std::string::npos; start = pos + slot_.size()) {
+            segments.push_back(std::make_shared<const std::string>(content, start, pos - start));
+        }
+        segments.push_back(std::make_shared<const std::string>(content, start));
+        segments_.swap(segments);
+        mtime_ns_ = mtime_ns;
+        size_ = st.st_size;
+        wwlog::GetLogger("asynclogger")->Info("template %s loaded, %u segments", template_path_.c_str(), segments_.size());
+        return true;
+    }
+
+private:
+    std::string template_path_;
+    std::string slot_;
+    std::map<std::string, std::string> constants_;
+
+    std::mutex mutex_;  // 保护下面所有成员，并发的首页请求只会生成一次列表
+    std::vector<Piece> segments_;  // 模板按 slot_ 切开的各段
+    int64_t mtime_ns_;
+    int64_t size_;
+    Piece list_;
+    uint64_t generation_;
+    bool rendered_;
+};
+
+}  // namespace wwstorage
@@ -6,6 +6,12 @@
 #include <thread>
 
 wwstorage::DataManager *data_;
+wwstorage::DecompressCache *cache_;
+wwstorage::CodecPool *codec_pool_;
+wwstorage::BlobStore *blob_store_ = nullptr;
+wwstorage::ChunkStore *chunk_store_ = nullptr;
+wwstorage::FileCache *file_cache_ = nullptr;
+wwstorage::TierManager *tier_manager_ = nullptr;
 
 void service_module()
 {
@@ -31,7 +37,45 @@ void log_system_module_init()
 int main(void)
 {
     log_system_module_init();
+    wwstorage::Tracer::Instance().Init(wwstorage::Config::GetInstance()->GetTraceSpans());
     data_ = new wwstorage::DataManager();
+    cache_ = new wwstorage::DecompressCache(wwstorage::Config::GetInstance()->GetCacheDir(),
+                                            wwstorage::Config::GetInstance()->GetCacheBytes());
+    cache_->Init();
+    codec_pool_ = new wwstorage::CodecPool(wwstorage::Config::GetInstance()->GetCodecThreads(),
+                                           wwstorage::Config::GetInstance()->GetCodecQueue());
+    codec_pool_->Start();
+    if (!wwstorage::Config::GetInstance()->GetBlobDir().empty()) {
+        blob_store_ = new wwstorage::BlobStore(wwstorage::Config::GetInstance()->GetBlobDir());
+        blob_store_->Init();
+    }
+    if (!wwstorage::Config::GetInstance()->GetChunkDir().empty()) {
+        chunk_store_ = new wwstorage::ChunkStore(wwstorage::Config::GetInstance()->GetChunkDir(),
+                                                 wwstorage::Config::GetInstance()->GetChunkAvgSize());
+        // 清单可能在 deep_storage 里，也可能是 blob 仓库里被硬链接的那份
+        chunk_store_->Init({wwstorage::Config::GetInstance()->GetDeepStorageDir(),
+                            wwstorage::Config::GetInstance()->GetBlobDir()});
+        wwstorage::DeepFile::SetChunkStore(chunk_store_);
+    }
+    if (wwstorage::Config::GetInstance()->GetFileCacheEntries() > 0) {
+        file_cache_ = new wwstorage::FileCache(wwstorage::Config::GetInstance()->GetFileCacheEntries());
+        std::vector<std::string> watch_dirs;
+        if (wwstorage::Config::GetInstance()->GetFileCacheInotify()) {
+            watch_dirs = {wwstorage::Config::GetInstance()->GetLowStorageDir(),
+                          wwstorage::Config::GetInstance()->GetDeepStorageDir()};
+        }
+        file_cache_->Init(watch_dirs);
+    }
+    if (wwstorage::Config::GetInstance()->GetTierIntervalSec() > 0) {
+        wwstorage::TierPolicy policy;
+        policy.interval_sec = wwstorage::Config::GetInstance()->GetTierIntervalSec();
+        policy.cold_seconds = wwstorage::Config::GetInstance()->GetTierColdSeconds();
+        policy.hot_hits = wwstorage::Config::GetInstance()->GetTierHotHits();
+        policy.rate_bytes = wwstorage::Config::GetInstance()->GetTierRateBytes();
+        tier_manager_ = new wwstorage::TierManager(data_, wwstorage::Config::GetInstance()->GetLowStorageDir(), policy,
+                                                   wwstorage::Service::MoveTier, wwstorage::Service::RemoveStorageFile);
+        tier_manager_->Start();
+    }
 
     std::thread t1(service_module);
     t1.join();
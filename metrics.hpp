@@ -0,0 +1,200 @@
+#pragma once
+
+#include <event2/buffer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#include "trace.hpp"
+
+namespace wwstorage {
+
+enum MetricCounter {
+    kCounterUploadBytes,
+    kCounterDownloadBytes,
+    kCounterDeepRawBytes,
+    kCounterDeepStoredBytes,
+    kCounterConnections,  // 打开 +1，关闭 -1
+    kCounterCount
+};
+
+// 前面是各个 handler 的请求耗时，后面是各个处理阶段的耗时
+enum MetricHistogram {
+    kHistUpload,
+    kHistStreamUpload,
+    kHistDownload,
+    kHistListShow,
+    kHistListFiles,
+    kStageReceive,
+    kStageCompress,
+    kStageWrite,
+    kStagePersist,
+    kStageSnapshot,
+    kStageDecompress,
+    kStageSend,
+    kHistCount
+};
+
+// 进程内的计数器和耗时直方图，按 Prometheus 文本格式输出。
+// 每个线程第一次记录时分到一个独占的槽（线程数超过槽数时才会共用），记录只是对本线程缓存行的
+// relaxed 原子加，没有锁也没有跨核竞争；抓取时把所有槽加起来。
+// 直方图是 HDR 风格的对数线性分桶：每个 2 的幂区间再等分 4 份，8us 到约 117s 的相对误差不超过 25%
+class Metrics {
+public:
+    static Metrics &Instance()
+    {
+        static Metrics metrics;
+        return metrics;
+    }
+    static uint64_t NowMicros()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    void Add(MetricCounter counter, int64_t n = 1)
+    {
+        Local().counters[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+    void Observe(MetricHistogram hist, uint64_t micros)
+    {
+        Slot &slot = Local();
+        size_t bucket = std::lower_bound(bounds_, bounds_ + kBuckets, micros) - bounds_;
+        slot.buckets[hist][bucket].fetch_add(1, std::memory_order_relaxed);
+        slot.sums[hist].fetch_add(micros, std::memory_order_relaxed);
+    }
+    // 从 start_us（NowMicros 的返回值）到现在，同时给当前请求记一个同名的 span
+    void ObserveSince(MetricHistogram hist, uint64_t start_us)
+    {
+        uint64_t now = NowMicros();
+        Observe(hist, now - start_us);
+        Tracer::Instance().Record(kHists[hist].value, start_us, now);
+    }
+
+    // 输出所有计数器和直方图
+    void Render(evbuffer *out)
+    {
+        for (int i = 0; i < kCounterCount; i++) {
+            uint64_t total = 0;
+            for (auto &slot : slots_) total += slot.counters[i].load(std::memory_order_relaxed);
+            const CounterInfo &info = kCounters[i];
+            evbuffer_add_printf(out, "# HELP %s %s\n# TYPE %s %s\n%s %lld\n", info.name, info.help, info.name,
+                                info.type, info.name, (long long)total);
+        }
+        for (int h = 0; h < kHistCount; h++) {
+            const HistInfo &info = kHists[h];
+            if (h == 0 || strcmp(info.name, kHists[h - 1].name) != 0) {
+                evbuffer_add_printf(out, "# HELP %s %s\n# TYPE %s histogram\n", info.name, info.help, info.name);
+            }
+            uint64_t count = 0, sum = 0;
+            for (auto &slot : slots_) sum += slot.sums[h].load(std::memory_order_relaxed);
+            for (size_t b = 0; b <= kBuckets; b++) {
+                for (auto &slot : slots_) count += slot.buckets[h][b].load(std::memory_order_relaxed);
+                if (b < kBuckets) {
+                    evbuffer_add_printf(out, "%s_bucket{%s=\"%s\",le=\"%g\"} %llu\n", info.name, info.label,
+                                        info.value, bounds_[b] / 1e6, (unsigned long long)count);
+                } else {
+                    evbuffer_add_printf(out, "%s_bucket{%s=\"%s\",le=\"+Inf\"} %llu\n", info.name, info.label,
+                                        info.value, (unsigned long long)count);
+                }
+            }
+            evbuffer_add_printf(out, "%s_sum{%s=\"%s\"} %g\n%s_count{%s=\"%s\"} %llu\n", info.name, info.label,
+                                info.value, sum / 1e6, info.name, info.label, info.value, (unsigned long long)count);
+        }
+    }
+    // 其他模块的统计值，抓取时现读
+    static void Gauge(evbuffer *out, const char *name, const char *help, double value)
+    {
+        evbuffer_add_printf(out, "# HELP %s %s\n# TYPE %s gauge\n%s %.17g\n", name, help, name, name, value);
+    }
+    static void Counter(evbuffer *out, const char *name, const char *help, uint64_t value)
+    {
+        evbuffer_add_printf(out, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help, name, name,
+                            (unsigned long long)value);
+    }
+
+private:
+    static const size_t kSlots = 64;
+    static const size_t kBuckets = 96;  // 另有一个溢出桶
+
+    struct CounterInfo {
+        const char *name;
+        const char *help;
+        const char *type;
+    };
+    struct HistInfo {
+        const char *name;
+        const char *help;
+        const char *label;
+        const char *value;
+    };
+    static constexpr CounterInfo kCounters[kCounterCount] = {
+        {"filerelay_upload_bytes_total", "Upload request body bytes received.", "counter"},
+        {"filerelay_download_bytes_total", "Download response body bytes queued for sending.", "counter"},
+        {"filerelay_deep_raw_bytes_total", "Raw bytes written into block containers (chunked files excluded).",
+         "counter"},
+        {"filerelay_deep_stored_bytes_total", "On-disk bytes of block containers written (chunked files excluded).",
+         "counter"},
+        {"filerelay_active_connections", "Open client connections.", "gauge"},
+    };
+    static constexpr HistInfo kHists[kHistCount] = {
+        {"filerelay_request_duration_seconds", "Time from request to reply per handler.", "handler", "upload"},
+        {"filerelay_request_duration_seconds", "", "handler", "stream_upload"},
+        {"filerelay_request_duration_seconds", "", "handler", "download"},
+        {"filerelay_request_duration_seconds", "", "handler", "list_show"},
+        {"filerelay_request_duration_seconds", "", "handler", "list_files"},
+        {"filerelay_stage_duration_seconds", "Time spent per processing stage.", "stage", "receive"},
+        {"filerelay_stage_duration_seconds", "", "stage", "compress"},
+        {"filerelay_stage_duration_seconds", "", "stage", "write"},
+        {"filerelay_stage_duration_seconds", "", "stage", "persist"},
+        {"filerelay_stage_duration_seconds", "", "stage", "snapshot"},
+        {"filerelay_stage_duration_seconds", "", "stage", "decompress"},
+        {"filerelay_stage_duration_seconds", "", "stage", "send"},
+    };
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> counters[kCounterCount];
+        std::atomic<uint64_t> buckets[kHistCount][kBuckets + 1];
+        std::atomic<uint64_t> sums[kHistCount];
+    };
+
+    Metrics() : next_slot_(0)
+    {
+        // 第 i 个桶的上界是 (4 + i % 4) * 2^(i / 4 + 1) 微秒
+        for (size_t i = 0; i < kBuckets; i++) bounds_[i] = (uint64_t)(4 + i % 4) << (i / 4 + 1);
+        for (auto &slot : slots_) {
+            for (auto &counter : slot.counters) counter = 0;
+            for (auto &hist : slot.buckets) {
+                for (auto &bucket : hist) bucket = 0;
+            }
+            for (auto &sum : slot.sums) sum = 0;
+        }
+    }
+    Slot &Local()
+    {
+        thread_local size_t index = next_slot_.fetch_add(1) % kSlots;
+        return slots_[index];
+    }
+
+private:
+    uint64_t bounds_[kBuckets];
+    Slot slots_[kSlots];
+    std::atomic<size_t> next_slot_;
+};
+
+// 作用域结束时记录耗时
+class MetricTimer {
+public:
+    explicit MetricTimer(MetricHistogram hist) : hist_(hist), start_(Metrics::NowMicros()) {}
+    ~MetricTimer() { Metrics::Instance().ObserveSince(hist_, start_); }
+
+private:
+    MetricHistogram hist_;
+    uint64_t start_;
+};
+
+}  // namespace wwstorage
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+
+#include "journal.hpp"
+#include "metrics.hpp"
+
+namespace wwstorage {
+
+// none: 后台线程批量写日志，不 fsync
+// batch: 后台线程批量写日志，每批 fdatasync 一次
+// sync: 在请求线程里逐条写日志并 fdatasync，返回时已经落盘
+enum DurabilityPolicy { kDurabilityNone, kDurabilityBatch, kDurabilitySync };
+
+static DurabilityPolicy ParseDurability(const std::string &policy)
+{
+    if (policy == "none") return kDurabilityNone;
+    if (policy == "sync") return kDurabilitySync;
+    return kDurabilityBatch;
+}
+
+// 组提交：修改先进入内存队列，同一个 key 在一批内只保留最后一条，
+// 每 interval_ms 或攒够 batch 条时由后台线程一次性写入日志
+class Persister {
+public:
+    Persister(Journal *journal, DurabilityPolicy policy, int interval_ms, int batch, int checkpoint_records,
+              const std::function<bool()> &snapshot)
+        : journal_(journal),
+          policy_(policy),
+          interval_ms_(interval_ms > 0 ? interval_ms : 1),
+          batch_(batch > 0 ? batch : 1),
+          checkpoint_records_(checkpoint_records),
+          snapshot_(snapshot),
+          stop_(false)
+    {
+    }
+    ~Persister() { Stop(); }
+
+    void Start()
+    {
+        if (policy_ == kDurabilitySync) return;
+        worker_ = std::thread(&Persister::Run, this);
+    }
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (worker_.joinable()) worker_.join();
+        Flush();
+    }
+    bool Submit(const std::string &key, const std::string &record)
+    {
+        if (policy_ == kDurabilitySync) {
+            std::lock_guard<std::mutex> commit_lock(commit_mutex_);
+            return Commit({record});
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = pending_index_.find(key);
+        if (it != pending_index_.end()) {
+            pending_[it->second] = record;
+        } else {
+            pending_index_[key] = pending_.size();
+            pending_.push_back(record);
+        }
+        if (pending_.size() >= batch_) cv_.notify_one();
+        return true;
+    }
+    // 把队列里的修改立即提交
+    bool Flush()
+    {
+        std::lock_guard<std::mutex> commit_lock(commit_mutex_);
+        std::vector<std::string> batch;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            batch.swap(pending_);
+            pending_index_.clear();
+        }
+        if (batch.empty()) return true;
+        return Commit(batch);
+    }
+
+private:
+    // 调用方需持有 commit_mutex_，保证各批次按取出的顺序写入日志
+    bool Commit(const std::vector<std::string> &records)
+    {
+        MetricTimer timer(kStagePersist);
+        if (journal_->Append(records) == false) {
+            // 日志写不进去就退回到整表快照
+            return journal_->Checkpoint(snapshot_);
+        }
+        if (policy_ != kDurabilityNone && journal_->Sync() == false) return false;
+        if (checkpoint_records_ > 0 && journal_->Records() >= (size_t)checkpoint_records_) {
+            return journal_->Checkpoint(snapshot_);
+        }
+        return true;
+    }
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            cv_.wait_for(lock, std::chrono::milliseconds(interval_ms_),
+                         [this]() { return stop_ || pending_.size() >= batch_; });
+            if (pending_.empty()) continue;
+            lock.unlock();
+            if (Flush() == false) wwlog::GetLogger("asynclogger")->Error("persister commit error.");
+            lock.lock();
+        }
+    }
+
+private:
+    Journal *journal_;
+    DurabilityPolicy policy_;
+    int interval_ms_;
+    size_t batch_;
+    int checkpoint_records_;
+    std::function<bool()> snapshot_;
+
+    std::mutex mutex_;  // 保护 pending_、pending_index_、stop_
+    std::condition_variable cv_;
+    std::vector<std::string> pending_;
+    std::unordered_map<std::string, size_t> pending_index_;
+    bool stop_;
+
+    std::mutex commit_mutex_;
+    std::thread worker_;
+};
+
+}  // namespace wwstorage
@@ -2,16 +2,41 @@
 
 #include <event.h>
 #include <event2/http.h>
+#include <event2/listener.h>
+#include <event2/thread.h>
 #include <evhttp.h>
 #include <fcntl.h>
+#include <netinet/tcp.h>
+#include <signal.h>
 #include <sys/stat.h>
 
-#include <regex>
+#include <thread>
+#include <unordered_set>
 
+#include "blob_store.hpp"
+#include "codec_advisor.hpp"
+#include "codec_pool.hpp"
+#include "codec_selector.hpp"
 #include "data_manager.hpp"
+#include "decompress_cache.hpp"
+#include "deep_file.hpp"
+#include "file_cache.hpp"
+#include "http_range.hpp"
+#include "json_stream.hpp"
+#include "key_lock.hpp"
+#include "list_page.hpp"
+#include "metrics.hpp"
 #include "lib/base64.h"
+#include "stream_upload.hpp"
+#include "tier_manager.hpp"
 
 extern wwstorage::DataManager *data_;
+extern wwstorage::DecompressCache *cache_;
+extern wwstorage::CodecPool *codec_pool_;
+extern wwstorage::BlobStore *blob_store_;
+extern wwstorage::ChunkStore *chunk_store_;
+extern wwstorage::FileCache *file_cache_;
+extern wwstorage::TierManager *tier_manager_;
 
 namespace wwstorage {
 class Service {
@@ -24,11 +49,114 @@ public:
         server_port_ = Config::GetInstance()->GetServerPort();
         server_ip_ = Config::GetInstance()->GetServerIp();
         download_prefix_ = Config::GetInstance()->GetDownloadPrefix();
+        upload_stream_port_ = Config::GetInstance()->GetUploadStreamPort();
+        worker_threads_ = Config::GetInstance()->GetWorkerThreads();
 #ifdef DEBUG_LOG
         wwlog::GetLogger("asynclogger")->Debug("Service construct end.");
 #endif
     }
+    // 每个工作线程各自一个 event_base/evhttp，监听同一个 SO_REUSEPORT 端口，由内核分发连接
     bool RunModule()
+    {
+        evthread_use_pthreads();
+        int workers = worker_threads_ > 0 ? worker_threads_ : std::max(1u, std::thread::hardware_concurrency());
+        wwlog::GetLogger("asynclogger")->Info("start %d worker threads.", workers);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < workers; i++) threads.emplace_back(&Service::RunWorker, this, i);
+        for (auto &thread : threads) thread.join();
+        return true;
+    }
+    // 冷热分层的迁移：low 文件压缩进 deep 或 deep 文件解压到 low，文件名不变所以 url 不变。
+    // 新文件和上传一样经过 StoreContent（去重、不原地改写），先写到目标目录里的临时文件，
+    // 持有文件名的发布锁，由 Replace 确认索引条目没变之后 rename 过去；期间有新上传时放弃，
+    // 旧文件由 TierManager 延迟删除
+    static bool MoveTier(const StorageInfo &info, bool to_deep)
+    {
+        Config *config = Config::GetInstance();
+        std::string dir = to_deep ? config->GetDeepStorageDir() : config->GetLowStorageDir();
+        File(dir).CreateDirectory();
+        std::string storage_path = dir + File(info.storage_path_).FileName();
+        std::string tmp_path = dir + ".tier-XXXXXX";
+        int fd = mkstemp(&tmp_path[0]);
+        if (fd == -1) {
+            wwlog::GetLogger("asynclogger")->Error("mkstemp %s error: %s", tmp_path.c_str(), strerror(errno));
+            return false;
+        }
+        close(fd);
+        bool ok = to_deep ? Demote(info.storage_path_, tmp_path) : Promote(info.storage_path_, tmp_path);
+
+        // 内容没变，mtime 保持上传时间
+        StorageInfo moved;
+        ok = ok && moved.NewStorageInfo(tmp_path);
+        moved.url_ = info.url_;
+        moved.storage_path_ = storage_path;
+        moved.mtime_ = info.mtime_;
+        moved.atime_ = info.atime_;
+        if (ok) {
+            KeyLock::Guard guard(PublishLock(), File(storage_path).FileName());
+            ok = data_->Replace(info, moved, tmp_path);
+            if (!ok) wwlog::GetLogger("asynclogger")->Info("tier move abandoned, %s changed.", info.url_.c_str());
+        }
+        if (ok == false) {
+            RemoveStorageFile(tmp_path);
+            return false;
+        }
+        if (file_cache_) {
+            file_cache_->Invalidate(storage_path);
+            file_cache_->Invalidate(info.storage_path_);
+        }
+        return true;
+    }
+    // 上传从写存储文件到写索引的整个过程和分层迁移的 rename 按文件名（即 url）互斥，
+    // 否则迁移的 rename 可能落在上传写好文件之后、写索引之前，把刚上传的内容换成旧内容
+    static KeyLock &PublishLock()
+    {
+        static KeyLock locks;
+        return locks;
+    }
+    // 删除存储文件。文件可能是 blob 的硬链接，经过 Unlink 删掉才能回收没人用的 blob
+    static void RemoveStorageFile(const std::string &path)
+    {
+        if (blob_store_) blob_store_->Unlink(path);
+        remove(path.c_str());
+    }
+
+private:
+    // /api/files 每页最多返回的条数
+    static const size_t kMaxListLimit = 1000;
+    // /api/codecs 最多抽样的文件数和每个文件取的 KB 数
+    static const size_t kMaxAdviseFiles = 256;
+    static const size_t kMaxAdviseSampleKb = 16 * 1024;
+    // 不超过这个大小的 deep 分块文件区间直接解压，不占用缓存
+    static const uint64_t kDirectRangeBytes = 4 * 1024 * 1024;
+    // 缓存文件段的清理回调参数
+    struct CachedSegment {
+        std::string key;
+        std::string path;
+    };
+    // 一次下载的状态，deep 文件在 codec 线程池里组装 body 时跨线程传递
+    struct DownloadJob {
+        DownloadJob()
+            : deep(false), size(0), range_result(kRangeIgnore), body(evbuffer_new()), ok(false),
+              start_us(Metrics::NowMicros()), trace(Tracer::Current())
+        {
+        }
+        ~DownloadJob() { evbuffer_free(body); }
+
+        StorageInfo info;
+        bool deep;
+        DeepFile deep_file;
+        uint64_t size;
+        RangeResult range_result;
+        std::vector<ByteRange> ranges;
+        std::string boundary;
+        evbuffer *body;
+        bool ok;
+        uint64_t start_us;
+        TraceContext trace;
+    };
+
+    bool RunWorker(int id)
     {
         // 初始化 libevent 和 HTTP 服务器
         event_base *base = event_base_new();
@@ -49,9 +177,13 @@ public:
         server_addr.sin_family = AF_INET;
         server_addr.sin_port = htons(server_port_);
 
-        // 绑定端口和 ip
-        if (evhttp_bind_socket(httpd, "0.0.0.0", server_port_) != 0) {
-            wwlog::GetLogger("asynclogger")->Fatal("evhttp_bind_socket error!");
+        // 绑定端口和 ip，listener 随 evhttp 一起释放
+        evconnlistener *listener = evconnlistener_new_bind(
+            base, nullptr, nullptr, LEV_OPT_REUSEABLE | LEV_OPT_REUSEABLE_PORT | LEV_OPT_CLOSE_ON_FREE, -1,
+            (sockaddr *)&server_addr, sizeof(server_addr));
+        if (listener == nullptr || evhttp_bind_listener(httpd, listener) == nullptr) {
+            wwlog::GetLogger("asynclogger")->Fatal("evhttp_bind_listener error!");
+            if (listener) evconnlistener_free(listener);
             evhttp_free(httpd);
             event_base_free(base);
             return false;
@@ -60,21 +192,37 @@ public:
         // 设置请求处理函数
         evhttp_set_gencb(httpd, GenHandler, nullptr);
 
+        // 同一时间只有一个 event_base 能收信号，SIGUSR1 交给第一个工作线程
+        event *dump_signal = nullptr;
+        if (id == 0 && Tracer::Instance().Enabled()) {
+            dump_signal = evsignal_new(base, SIGUSR1, DumpTraces, nullptr);
+            if (dump_signal) event_add(dump_signal, nullptr);
+        }
+
+        // 流式上传单独监听一个端口，请求体边收边写盘，不经过 evhttp 的内存缓冲
+        std::unique_ptr<StreamUploadServer> stream_upload;
+        if (upload_stream_port_ > 0) {
+            stream_upload.reset(new StreamUploadServer(Config::GetInstance()->GetLowStorageDir(),
+                                                       Config::GetInstance()->GetUploadStreamBuffer(),
+                                                       StreamUploadDone));
+            if (stream_upload->Start(base, upload_stream_port_) == false) stream_upload.reset();
+        }
+
         if (base) {
 #ifdef DEBUG_LOG
-            wwlog::GetLogger("asynclogger")->Debug("event_base_dispatch.");
+            wwlog::GetLogger("asynclogger")->Debug("worker %d event_base_dispatch.", id);
 #endif
             if (event_base_dispatch(base) == -1) {
                 wwlog::GetLogger("asynclogger")->Fatal("event_base_dispatch error!");
             }
         }
 
+        stream_upload.reset();
+        if (dump_signal) event_free(dump_signal);
         if (httpd) evhttp_free(httpd);
         if (base) event_base_free(base);
         return true;
     }
-
-private:
     static std::string GenerateModernFileList(const std::vector<StorageInfo> &files)
     {
         std::stringstream ss_html;
@@ -105,12 +253,31 @@ private:
     }
     static void GenHandler(struct evhttp_request *request, void *arg)
     {
+        // 响应头和 sendfile 的文件体分两次写，不关 Nagle 会和客户端的延迟 ACK 叠加出 40ms 的等待
+        int on = 1;
+        evhttp_connection *conn = evhttp_request_get_connection(request);
+        evutil_socket_t fd = bufferevent_getfd(evhttp_connection_get_bufferevent(conn));
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        TrackConnection(conn);
+
+        // 同步处理期间的日志和 span 都归到这个请求，异步的部分由各 handler 把上下文带过去
+        const char *debug_log = evhttp_find_header(request->input_headers, "X-Debug-Log");
+        TraceScope trace(Tracer::Instance().NewContext(debug_log != nullptr && strcmp(debug_log, "1") == 0));
+
         std::string path = evhttp_uri_get_path(evhttp_request_get_evhttp_uri(request));
         path = UrlDecode(path);
-        wwlog::GetLogger("asynclogger")->Info("request path: %s", path.c_str());
+        REQUEST_LOG("request path: %s", path.c_str());
 
         if (path.find("/download/") != std::string::npos) {
             Download(request, arg);
+        } else if (path == "/api/files") {
+            ListFiles(request, arg);
+        } else if (path == "/metrics") {
+            ShowMetrics(request, arg);
+        } else if (path == "/api/codecs") {
+            AdviseCodecs(request, arg);
+        } else if (path == "/debug/traces") {
+            ShowTraces(request, arg);
         } else if (path.find("/upload") != std::string::npos) {
             Upload(request, arg);
         } else if (path.find("/") != std::string::npos) {
@@ -119,9 +286,24 @@ private:
             evhttp_send_error(request, HTTP_NOTFOUND, "Not Found");
         }
     }
+    // evhttp 没有新连接的回调，连接上第一个请求到达时开始计数，连接关闭时减掉
+    static void TrackConnection(evhttp_connection *conn)
+    {
+        thread_local std::unordered_set<evhttp_connection *> tracked;
+        if (tracked.insert(conn).second == false) return;
+        Metrics::Instance().Add(kCounterConnections);
+        evhttp_connection_set_closecb(conn, ConnectionClosed, &tracked);
+    }
+    static void ConnectionClosed(evhttp_connection *conn, void *arg)
+    {
+        if (((std::unordered_set<evhttp_connection *> *)arg)->erase(conn) > 0) {
+            Metrics::Instance().Add(kCounterConnections, -1);
+        }
+    }
     static void Upload(struct evhttp_request *request, void *arg)
     {
-        wwlog::GetLogger("asynclogger")->Info("Upload() start.");
+        REQUEST_LOG("Upload() start.");
+        uint64_t start_us = Metrics::NowMicros();
 
         struct evbuffer *buffer = evhttp_request_get_input_buffer(request);
         if (buffer == nullptr) {
@@ -130,12 +312,13 @@ private:
             return;
         }
         size_t len = evbuffer_get_length(buffer);
-        wwlog::GetLogger("asynclogger")->Info("Upload() receive data length: %u", len);
+        REQUEST_LOG("Upload() receive data length: %u", len);
         if (len == 0) {
             wwlog::GetLogger("asynclogger")->Error("Upload() receive data length is zero.");
             evhttp_send_error(request, HTTP_BADREQUEST, "Bad Request");
             return;
         }
+        Metrics::Instance().Add(kCounterUploadBytes, len);
         std::string content(len, 0);
         if (-1 == evbuffer_copyout(buffer, (void *)content.c_str(), len)) {
             wwlog::GetLogger("asynclogger")->Error("evbuffer_copyout error.");
@@ -169,34 +352,234 @@ private:
         wwlog::GetLogger("asynclogger")->Debug("final storage path: %s", storage_path.c_str());
 #endif
 
-        // 看路径里是 low 还是 deep 存储，是 deep 就压缩，是 low 就直接写入
-        File file(storage_path);
-        if (storage_path.find("low_storage") != std::string::npos) {
-            if (file.SetContent(content.c_str(), content.size()) == false) {
-                wwlog::GetLogger("asynclogger")->Error("low_storage write error.");
-                evhttp_send_reply(request, HTTP_INTERNAL, "Internal Server Error", nullptr);
-                return;
-            } else {
-                wwlog::GetLogger("asynclogger")->Info("low_storage success.");
-            }
-        } else {
-            if (file.Compress(content, Config::GetInstance()->GetBundleFormat()) == false) {
-                wwlog::GetLogger("asynclogger")->Error("deep_storage compress error.");
-                evhttp_send_reply(request, HTTP_INTERNAL, "Internal Server Error", nullptr);
-                return;
-            } else {
-                wwlog::GetLogger("asynclogger")->Info("deep_storage success.");
+        // 写盘和压缩交给 codec 线程池，完成后回到本线程回复
+        auto body = std::make_shared<std::string>(std::move(content));
+        auto status = std::make_shared<int>(HTTP_OK);
+        TraceContext trace = Tracer::Current();
+        auto work = [body, storage_path, status, trace]() {
+            TraceScope scope(trace);
+            *status = StoreUpload(storage_path, *body);
+        };
+        auto done = [request, status, start_us, trace]() {
+            TraceScope scope(trace);
+            evhttp_send_reply(request, *status, *status == HTTP_OK ? "OK" : "Internal Server Error", nullptr);
+            Metrics::Instance().ObserveSince(kHistUpload, start_us);
+            REQUEST_LOG("upload finish: %d", *status);
+        };
+        if (codec_pool_->Submit(BaseOf(request), work, done) == false) {
+            evhttp_send_reply(request, HTTP_SERVUNAVAIL, "Service Unavailable", nullptr);
+        }
+    }
+    // 在 codec 线程池里执行：看路径里是 low 还是 deep 存储，是 deep 就压缩，是 low 就直接写入
+    static int StoreUpload(const std::string &storage_path, const std::string &content)
+    {
+        bool deep = storage_path.find("low_storage") == std::string::npos;
+        std::string hash = blob_store_ ? Sha256::Hash(content) : "";
+        auto write = [&content, deep](const std::string &path) {
+            if (deep == false) {
+                MetricTimer timer(kStageWrite);
+                return File(path).SetContent(content.c_str(), content.size());
             }
+            MetricTimer timer(kStageCompress);
+            int format = DeepFormat(content.data(), content.size());
+            ContentEncoding encoding = DeepEncoding(format, content.size());
+            bool ok = DeepFile::Write(path, content, format, Config::GetInstance()->GetDeepBlockSize(),
+                                      Config::GetInstance()->GetCompressThreads(), encoding);
+            if (ok) CountDeepWrite(path, content.size(), encoding);
+            return ok;
+        };
+        KeyLock::Guard guard(PublishLock(), File(storage_path).FileName());
+        bool ok = StoreContent(storage_path, deep, hash, content.size(), write);
+        if (file_cache_) file_cache_->Invalidate(storage_path);
+        if (ok == false) {
+            wwlog::GetLogger("asynclogger")->Error("%s write error.", deep ? "deep_storage" : "low_storage");
+            return HTTP_INTERNAL;
         }
+        REQUEST_LOG("%s success.", deep ? "deep_storage" : "low_storage");
 
         // 添加存储文件信息
         StorageInfo info;
         info.NewStorageInfo(storage_path);
+        // 存储文件可能是共享 blob 的硬链接，inode 的时间是内容第一次写入的时间，这次上传的时间只记在索引里
+        info.mtime_ = info.atime_ = time(nullptr);
         data_->Insert(info);
+        return HTTP_OK;
+    }
+    // 把内容落到 storage_path。开启 blob 仓库时按 sha256 去重：同样的内容已经存过就只建一个硬链接，
+    // deep 文件连压缩都省掉；没存过就由 write 写进仓库的临时文件，收进仓库后再链接过去。
+    // 存储文件可能和别的文件共享 inode，任何情况下都不能原地改写
+    static bool StoreContent(const std::string &storage_path, bool deep, const std::string &hash, uint64_t size,
+                             const std::function<bool(const std::string &)> &write)
+    {
+        if (blob_store_ == nullptr) {
+            struct stat st;
+            if (stat(storage_path.c_str(), &st) == 0 && st.st_nlink > 1) remove(storage_path.c_str());
+            return write(storage_path);
+        }
+        const char *kind = deep ? "deep" : "low";
+        if (blob_store_->Link(hash, kind, storage_path)) {
+            blob_store_->CountHit(size);
+            REQUEST_LOG("dedup hit: %s -> %s", storage_path.c_str(), hash.c_str());
+            return true;
+        }
+        std::string tmp = blob_store_->TempPath();
+        if (write(tmp) == false) {
+            remove(tmp.c_str());
+            return false;
+        }
+        return blob_store_->AdoptAndLink(tmp, hash, kind, storage_path);
+    }
+    // 压缩率的原始/落盘字节数。进块仓库的文件只有清单在这里，块的字节数看块仓库自己的统计
+    static void CountDeepWrite(const std::string &path, uint64_t raw, ContentEncoding encoding)
+    {
+        if (DeepFile::Chunked(encoding)) return;
+        Metrics::Instance().Add(kCounterDeepRawBytes, raw);
+        Metrics::Instance().Add(kCounterDeepStoredBytes, File(path).Size());
+    }
+    // 流式上传接收完毕：校验后把落盘交给 codec 线程池，reply 回到 base 线程执行
+    static void StreamUploadDone(event_base *base, const StreamUpload &upload, const StreamUploadReply &reply)
+    {
+        TraceScope trace(upload.trace);
+        std::string filename = base64_decode(upload.Header("filename"));
+        if (filename.empty() || filename.find('/') != std::string::npos) {
+            wwlog::GetLogger("asynclogger")->Info("stream upload illegal file name.");
+            return reply(HTTP_BADREQUEST);
+        }
+        std::string storage_type = upload.Header("storagetype");
+        std::string storage_path;
+        if (storage_type == "low") {
+            storage_path = Config::GetInstance()->GetLowStorageDir();
+        } else if (storage_type == "deep") {
+            storage_path = Config::GetInstance()->GetDeepStorageDir();
+        } else {
+            wwlog::GetLogger("asynclogger")->Info("stream upload illegal storage type.");
+            return reply(HTTP_BADREQUEST);
+        }
+        File dir_create(storage_path);
+        dir_create.CreateDirectory();
+        storage_path += filename;
+
+        auto status = std::make_shared<int>(HTTP_OK);
+        bool deep = storage_type == "deep";
+        auto work = [upload, storage_path, deep, status]() {
+            TraceScope scope(upload.trace);
+            *status = StoreStreamUpload(upload, storage_path, deep);
+        };
+        uint64_t start_us = upload.start_us;
+        TraceContext context = upload.trace;
+        auto done = [reply, status, start_us, context]() {
+            TraceScope scope(context);
+            reply(*status);
+            Metrics::Instance().ObserveSince(kHistStreamUpload, start_us);
+        };
+        if (codec_pool_->Submit(base, work, done) == false) reply(HTTP_SERVUNAVAIL);
+    }
+    // 在 codec 线程池里执行：low 直接把临时文件 rename 过去，deep 压缩，最后临时文件总会删掉
+    static int StoreStreamUpload(const StreamUpload &upload, const std::string &storage_path, bool deep)
+    {
+        const std::string &tmp_path = upload.tmp_path;
+        auto write = [&tmp_path, deep, &upload](const std::string &path) {
+            if (deep == false) {
+                MetricTimer timer(kStageWrite);
+                return rename(tmp_path.c_str(), path.c_str()) == 0;
+            }
+            MetricTimer timer(kStageCompress);
+            std::string sample;
+            File tmp(tmp_path);
+            tmp.GetPosLen(&sample, 0, std::min<int64_t>(tmp.Size(), Config::GetInstance()->GetCodecSampleBytes()));
+            int format = DeepFormat(sample.data(), sample.size());
+            ContentEncoding encoding = DeepEncoding(format, upload.length);
+            bool ok = DeepFile::WriteFile(path, tmp_path, format, Config::GetInstance()->GetDeepBlockSize(),
+                                          Config::GetInstance()->GetCompressThreads(), encoding);
+            if (ok) CountDeepWrite(path, upload.length, encoding);
+            return ok;
+        };
+        KeyLock::Guard guard(PublishLock(), File(storage_path).FileName());
+        bool ok = StoreContent(storage_path, deep, upload.sha256, upload.length, write);
+        remove(tmp_path.c_str());
+        if (file_cache_) file_cache_->Invalidate(storage_path);
+        if (!ok) {
+            wwlog::GetLogger("asynclogger")
+                ->Error("%s write error: %s", deep ? "deep_storage" : "low_storage", strerror(errno));
+            return HTTP_INTERNAL;
+        }
 
-        // 返回成功响应
-        evhttp_send_reply(request, HTTP_OK, "OK", nullptr);
-        wwlog::GetLogger("asynclogger")->Info("upload finish!");
+        StorageInfo info;
+        info.NewStorageInfo(storage_path);
+        // 存储文件可能是共享 blob 的硬链接，inode 的时间是内容第一次写入的时间，这次上传的时间只记在索引里
+        info.mtime_ = info.atime_ = time(nullptr);
+        data_->Insert(info);
+        REQUEST_LOG("stream upload finish: %s", storage_path.c_str());
+        return HTTP_OK;
+    }
+    // 把 low 文件 src 按上传 deep 文件的规则压缩成 dst，不可压缩的文件留在 low。dst 是 MoveTier 的临时文件
+    static bool Demote(const std::string &src, const std::string &dst)
+    {
+        File file(src);
+        int64_t size = file.Size();
+        std::string sample;
+        size_t sample_len = std::min<int64_t>(size, Config::GetInstance()->GetCodecSampleBytes());
+        if (file.GetPosLen(&sample, 0, sample_len) == false) return false;
+        int format = DeepFormat(sample.data(), sample.size());
+        if (format == bundle::RAW) {
+            wwlog::GetLogger("asynclogger")->Info("%s is incompressible, keep in low_storage.", src.c_str());
+            return false;
+        }
+        std::string hash = blob_store_ ? Sha256::HashFile(src) : "";
+        if (blob_store_ && hash.empty()) return false;
+        auto write = [&src, format, size](const std::string &path) {
+            MetricTimer timer(kStageCompress);
+            ContentEncoding encoding = DeepEncoding(format, size);
+            bool ok = DeepFile::WriteFile(path, src, format, Config::GetInstance()->GetDeepBlockSize(),
+                                          Config::GetInstance()->GetCompressThreads(), encoding);
+            if (ok) CountDeepWrite(path, size, encoding);
+            return ok;
+        };
+        return StoreContent(dst, true, hash, size, write);
+    }
+    // 把 deep 文件 src 解压成 low 文件 dst（MoveTier 的临时文件），先解压到 low_storage 里的另一个临时文件，
+    // 再经过 StoreContent 去重或 rename 过去
+    static bool Promote(const std::string &src, const std::string &dst)
+    {
+        DeepFile deep_file;
+        deep_file.SetThreads(Config::GetInstance()->GetCompressThreads());
+        if (deep_file.Open(src) == false) return false;
+        std::string tmp_path = Config::GetInstance()->GetLowStorageDir() + ".tier-XXXXXX";
+        int fd = mkstemp(&tmp_path[0]);
+        if (fd == -1) {
+            wwlog::GetLogger("asynclogger")->Error("mkstemp %s error: %s", tmp_path.c_str(), strerror(errno));
+            return false;
+        }
+        close(fd);
+        bool ok = deep_file.DecodeTo(tmp_path);
+        std::string hash = ok && blob_store_ ? Sha256::HashFile(tmp_path) : "";
+        ok = ok && (blob_store_ == nullptr || !hash.empty());
+        auto write = [&tmp_path](const std::string &path) { return rename(tmp_path.c_str(), path.c_str()) == 0; };
+        ok = ok && StoreContent(dst, false, hash, deep_file.RawSize(), write);
+        remove(tmp_path.c_str());
+        return ok;
+    }
+    // deep 文件的编码：fixed 模式用 bundle_format，adaptive 模式按文件开头的样本挑选。
+    // 编码写在每个块的 bundle 头里，解压时由 bundle::unpack 自动识别
+    static int DeepFormat(const char *data, size_t len)
+    {
+        Config *config = Config::GetInstance();
+        if (config->GetCodecMode() != "adaptive") return config->GetBundleFormat();
+        CodecPolicy policy;
+        policy.target = ParseCodecTarget(config->GetCodecTarget());
+        policy.raw_entropy = config->GetCodecRawEntropy();
+        policy.raw_ratio = config->GetCodecRawRatio();
+        return ChooseCodec(data, std::min(len, config->GetCodecSampleBytes()), policy);
+    }
+    // 配置了 deep_content_encoding 时 deep 文件按 HTTP 能解码的格式存储；
+    // 样本判定为不可压缩（RAW）的文件压了也没用，仍按 bundle 存，下载时解压只是拷贝；
+    // gzip 要把整个文件放进内存压成一个块，超过 deep_gzip_max_size 的文件改用 zstd 分块
+    static ContentEncoding DeepEncoding(int format, uint64_t size)
+    {
+        if (format == bundle::RAW) return kEncodingBundle;
+        ContentEncoding encoding = ParseContentEncoding(Config::GetInstance()->GetDeepContentEncoding());
+        if (encoding == kEncodingGzip && size > Config::GetInstance()->GetDeepGzipMaxSize()) return kEncodingZstd;
+        return encoding;
     }
     static void Download(struct evhttp_request *request, void *arg)
     {
@@ -205,107 +588,498 @@ private:
         StorageInfo info;
         std::string resource_path = evhttp_uri_get_path(evhttp_request_get_evhttp_uri(request));
         resource_path = UrlDecode(resource_path);
-        data_->GetOneByURL(resource_path, &info);
-        wwlog::GetLogger("asynclogger")->Info("request resource_path:%s", resource_path.c_str());
-
-        std::string download_path = info.storage_path_;
-        // 2.如果压缩过了就解压到新文件给用户下载
-        if (info.storage_path_.find(Config::GetInstance()->GetLowStorageDir()) == std::string::npos) {
-            wwlog::GetLogger("asynclogger")->Info("uncompressing:%s", info.storage_path_.c_str());
-            File fu(info.storage_path_);
-            download_path =
-                Config::GetInstance()->GetLowStorageDir() +
-                std::string(download_path.begin() + download_path.find_last_of('/') + 1, download_path.end());
-            File dirCreate(Config::GetInstance()->GetLowStorageDir());
-            dirCreate.CreateDirectory();
-            fu.UnCompress(download_path);  // 将文件解压到low_storage下去或者再创一个文件夹做中转
-        }
-        wwlog::GetLogger("asynclogger")->Info("request download_path:%s", download_path.c_str());
-        File fu(download_path);
-        if (fu.Exists() == false && info.storage_path_.find("deep_storage") != std::string::npos) {
-            // 如果是压缩文件，且解压失败，是服务端的错误
-            wwlog::GetLogger("asynclogger")->Info("evhttp_send_reply: 500 - UnCompress failed");
-            evhttp_send_reply(request, HTTP_INTERNAL, NULL, NULL);
-        } else if (fu.Exists() == false && info.storage_path_.find("low_storage") == std::string::npos) {
-            // 如果是普通文件，且文件不存在，是客户端的错误
-            wwlog::GetLogger("asynclogger")->Info("evhttp_send_reply: 400 - bad request,file not exists");
-            evhttp_send_reply(request, HTTP_BADREQUEST, "file not exists", NULL);
+        REQUEST_LOG("request resource_path:%s", resource_path.c_str());
+        if (data_->GetOneByURL(resource_path, &info) == false) {
+            wwlog::GetLogger("asynclogger")->Info("evhttp_send_reply: 404 - %s not found", resource_path.c_str());
+            evhttp_send_reply(request, HTTP_NOTFOUND, "file not exists", NULL);
+            return;
         }
+        if (tier_manager_) tier_manager_->Touch(info.url_);
 
-        // 3.确认文件是否需要断点续传
-        bool retrans = false;
-        std::string old_etag;
-        auto if_range = evhttp_find_header(request->input_headers, "If-Range");
-        if (NULL != if_range) {
-            old_etag = if_range;
-            // 有If-Range字段且，这个字段的值与请求文件的最新etag一致则符合断点续传
-            if (old_etag == GetETag(info)) {
-                retrans = true;
-                wwlog::GetLogger("asynclogger")
-                    ->Info("%s need breakpoint continuous transmission", download_path.c_str());
+        // 3. 取原始数据大小，deep 文件的 fsize_ 是压缩后的大小，要从文件头读
+        auto job = std::make_shared<DownloadJob>();
+        job->info = info;
+        job->deep = info.storage_path_.find(Config::GetInstance()->GetLowStorageDir()) == std::string::npos;
+        if (job->deep) {
+            job->deep_file.SetThreads(Config::GetInstance()->GetCompressThreads());
+            if (job->deep_file.Open(info.storage_path_) == false) {
+                // 如果是压缩文件，且打不开，是服务端的错误
+                wwlog::GetLogger("asynclogger")->Info("evhttp_send_reply: 500 - open deep file failed");
+                evhttp_send_reply(request, HTTP_INTERNAL, NULL, NULL);
+                return;
             }
+            job->size = job->deep_file.RawSize();
+        } else if (LowSize(info.storage_path_, &job->size) == false) {
+            wwlog::GetLogger("asynclogger")->Info("%s not exists", info.storage_path_.c_str());
+            evhttp_send_reply(request, HTTP_NOTFOUND, "file not exists", NULL);
+            return;
+        }
+
+        // 4. 解析 Range；带 If-Range 且与最新 ETag 不一致说明文件已经变了，按完整文件返回
+        auto range = evhttp_find_header(request->input_headers, "Range");
+        auto if_range = evhttp_find_header(request->input_headers, "If-Range");
+        if (NULL != range && (NULL == if_range || GetETag(info) == if_range)) {
+            job->range_result = ParseRange(range, job->size, &job->ranges);
         }
 
-        // 4. 读取文件数据，放入rsp.body中
-        if (fu.Exists() == false) {
-            wwlog::GetLogger("asynclogger")->Info("%s not exists", download_path.c_str());
-            download_path += "not exists";
-            evhttp_send_reply(request, 404, download_path.c_str(), NULL);
+        // 整文件请求且客户端能解码存储用的编码时，不解压，带 Content-Encoding 直接发送存储的字节。
+        // 编码后的表示和原始内容是不同的表示，ETag 也要区分
+        ContentEncoding encoding = job->deep ? job->deep_file.Encoding() : kEncodingBundle;
+        bool encoded = encoding != kEncodingBundle && job->range_result == kRangeIgnore &&
+                       AcceptsEncoding(evhttp_find_header(request->input_headers, "Accept-Encoding"),
+                                       ContentEncodingName(encoding));
+
+        // 5. 设置响应头部字段： ETag， Accept-Ranges: bytes
+        evhttp_add_header(request->output_headers, "Accept-Ranges", "bytes");
+        std::string etag = GetETag(info);
+        if (encoded) etag += std::string("-") + ContentEncodingName(encoding);
+        evhttp_add_header(request->output_headers, "ETag", etag.c_str());
+        if (encoding != kEncodingBundle) evhttp_add_header(request->output_headers, "Vary", "Accept-Encoding");
+        if (job->range_result == kRangeUnsatisfiable) {
+            std::string content_range = "bytes */" + std::to_string(job->size);
+            evhttp_add_header(request->output_headers, "Content-Range", content_range.c_str());
+            evhttp_send_reply(request, 416, "Range Not Satisfiable", NULL);
+            wwlog::GetLogger("asynclogger")->Info("evhttp_send_reply: 416 - %s", range);
             return;
         }
-        evbuffer *outbuf = evhttp_request_get_output_buffer(request);
-        int fd = open(download_path.c_str(), O_RDONLY);
-        if (fd == -1) {
-            wwlog::GetLogger("asynclogger")->Error("open file error: %s -- %s", download_path.c_str(), strerror(errno));
-            evhttp_send_reply(request, HTTP_INTERNAL, strerror(errno), NULL);
+        if (job->range_result == kRangeIgnore || job->ranges.size() == 1) {
+            evhttp_add_header(request->output_headers, "Content-Type", "application/octet-stream");
+        }
+        if (job->range_result == kRangeSatisfiable && job->ranges.size() == 1) {
+            evhttp_add_header(request->output_headers, "Content-Range",
+                              ContentRange(job->ranges[0], job->size).c_str());
+        }
+        if (job->range_result == kRangeSatisfiable && job->ranges.size() > 1) {
+            // 多区间：multipart/byteranges，每段带自己的 Content-Range
+            job->boundary = GetETag(info);
+            job->boundary =
+                "filerelay-" + std::to_string(std::hash<std::string>()(job->boundary) ^ (uint64_t)time(nullptr));
+            std::string content_type = "multipart/byteranges; boundary=" + job->boundary;
+            evhttp_add_header(request->output_headers, "Content-Type", content_type.c_str());
+        }
+
+        // 6. 读取文件数据，只放入请求的区间。low 文件和不用解压的 deep 文件只是挂上文件段，直接在本线程做；
+        // 其余 deep 文件要解压，交给 codec 线程池，完成后回到本线程发送
+        if (encoded) {
+            evhttp_add_header(request->output_headers, "Content-Encoding", ContentEncodingName(encoding));
+            std::vector<FileSegment> segments;
+            job->deep_file.EncodedSegments(&segments);
+            job->ok = true;
+            for (size_t i = 0; job->ok && i < segments.size(); i++) {
+                job->ok = AddLowRange(job->body, segments[i].path, {segments[i].offset, segments[i].length});
+            }
+            SendDownload(request, job.get());
             return;
         }
-        // 和前面用的evbuffer_add类似，但是效率更高，具体原因可以看函数声明
-        if (-1 == evbuffer_add_file(outbuf, fd, 0, fu.Size())) {
+        if (job->deep == false) {
+            BuildDownloadBody(job.get());
+            SendDownload(request, job.get());
+            return;
+        }
+        auto work = [job]() {
+            TraceScope scope(job->trace);
+            MetricTimer timer(kStageDecompress);
+            BuildDownloadBody(job.get());
+        };
+        auto done = [request, job]() {
+            TraceScope scope(job->trace);
+            SendDownload(request, job.get());
+        };
+        if (codec_pool_->Submit(BaseOf(request), work, done) == false) {
+            evhttp_send_reply(request, HTTP_SERVUNAVAIL, "Service Unavailable", NULL);
+        }
+    }
+    // 按 job 里的区间把响应体组装进 job->body，可以在任意线程执行
+    static void BuildDownloadBody(DownloadJob *job)
+    {
+        const StorageInfo &info = job->info;
+        evbuffer *body = job->body;
+        if (job->range_result == kRangeIgnore) {
+            job->ok = job->deep ? AddDeepRange(body, info, &job->deep_file, job->size, {0, job->size})
+                                : AddLowRange(body, info.storage_path_, {0, job->size});
+        } else if (job->ranges.size() == 1) {
+            job->ok = job->deep ? AddDeepRange(body, info, &job->deep_file, job->size, job->ranges[0])
+                                : AddLowRange(body, info.storage_path_, job->ranges[0]);
+        } else {
+            job->ok = true;
+            for (size_t i = 0; job->ok && i < job->ranges.size(); i++) {
+                evbuffer_add_printf(body,
+                                    "\r\n--%s\r\n"
+                                    "Content-Type: application/octet-stream\r\n"
+                                    "Content-Range: %s\r\n\r\n",
+                                    job->boundary.c_str(), ContentRange(job->ranges[i], job->size).c_str());
+                job->ok = job->deep ? AddDeepRange(body, info, &job->deep_file, job->size, job->ranges[i])
+                                    : AddLowRange(body, info.storage_path_, job->ranges[i]);
+            }
+            evbuffer_add_printf(body, "\r\n--%s--\r\n", job->boundary.c_str());
+        }
+    }
+    static void SendDownload(struct evhttp_request *request, DownloadJob *job)
+    {
+        if (job->ok == false) {
+            evhttp_send_reply(request, HTTP_INTERNAL, NULL, NULL);
             wwlog::GetLogger("asynclogger")
-                ->Error("evbuffer_add_file: %d -- %s -- %s", fd, download_path.c_str(), strerror(errno));
+                ->Info("evhttp_send_reply: 500 - read %s failed", job->info.storage_path_.c_str());
+            return;
         }
-        // 5. 设置响应头部字段： ETag， Accept-Ranges: bytes
-        evhttp_add_header(request->output_headers, "Accept-Ranges", "bytes");
-        evhttp_add_header(request->output_headers, "ETag", GetETag(info).c_str());
-        evhttp_add_header(request->output_headers, "Content-Type", "application/octet-stream");
-        if (retrans == false) {
+        Metrics::Instance().Add(kCounterDownloadBytes, evbuffer_get_length(job->body));
+        Metrics::Instance().ObserveSince(kHistDownload, job->start_us);
+        // 响应全部写进 socket 后记录发送耗时
+        evhttp_request_set_on_complete_cb(request, SendComplete, (void *)(uintptr_t)Metrics::NowMicros());
+        // 只移动 chain，文件段不会被复制
+        evbuffer_add_buffer(evhttp_request_get_output_buffer(request), job->body);
+        if (job->range_result == kRangeIgnore) {
             evhttp_send_reply(request, HTTP_OK, "Success", NULL);
-            wwlog::GetLogger("asynclogger")->Info("evhttp_send_reply: HTTP_OK");
+            REQUEST_LOG("evhttp_send_reply: HTTP_OK");
         } else {
-            evhttp_send_reply(request, 206, "breakpoint continuous transmission", NULL);  // 区间请求响应的是206
-            wwlog::GetLogger("asynclogger")->Info("evhttp_send_reply: 206");
+            evhttp_send_reply(request, 206, "Partial Content", NULL);  // 区间请求响应的是206
+            REQUEST_LOG("evhttp_send_reply: 206");
+        }
+    }
+    // 发送在请求处理结束后由 evhttp 完成，这个 span 不带请求 id
+    static void SendComplete(struct evhttp_request *request, void *arg)
+    {
+        Metrics::Instance().ObserveSince(kStageSend, (uint64_t)(uintptr_t)arg);
+    }
+    static event_base *BaseOf(struct evhttp_request *request)
+    {
+        return evhttp_connection_get_base(evhttp_request_get_connection(request));
+    }
+    // low_storage 文件的大小，开启 fd 缓存时热文件不用 stat
+    static bool LowSize(const std::string &path, uint64_t *size)
+    {
+        if (file_cache_) return file_cache_->Stat(path, size);
+        File fu(path);
+        if (fu.Exists() == false) return false;
+        *size = fu.Size();
+        return true;
+    }
+    // 把文件的一段直接交给 evbuffer（low_storage 文件的区间、不用解压的 deep 文件段），发送时走 sendfile，不经过用户态。
+    // 开启 fd 缓存时挂的是缓存里共享的文件段，不用每次 open
+    static bool AddLowRange(evbuffer *outbuf, const std::string &path, const ByteRange &range)
+    {
+        if (file_cache_) return file_cache_->AddRange(outbuf, path, range.start, range.length);
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            wwlog::GetLogger("asynclogger")->Error("open file error: %s -- %s", path.c_str(), strerror(errno));
+            return false;
         }
-        if (download_path != info.storage_path_) {
-            remove(download_path.c_str());  // 删除文件
+        // 和前面用的evbuffer_add类似，但是效率更高，具体原因可以看函数声明
+        if (-1 == evbuffer_add_file(outbuf, fd, range.start, range.length)) {
+            wwlog::GetLogger("asynclogger")
+                ->Error("evbuffer_add_file: %d -- %s -- %s", fd, path.c_str(), strerror(errno));
+            return false;
         }
+        return true;
     }
-    static void ListShow(struct evhttp_request *request, void *arg)
+    // deep 文件的区间：小区间直接解压覆盖到的块，大区间和整文件走解压缓存，重复下载直接 sendfile
+    static bool AddDeepRange(evbuffer *outbuf, const StorageInfo &info, DeepFile *deep_file, uint64_t size,
+                             const ByteRange &range)
     {
-        wwlog::GetLogger("asynclogger")->Info("ListShow()");
+        if (deep_file->RandomAccess() && range.length <= kDirectRangeBytes) {
+            std::string content;
+            if (deep_file->ReadRange(range.start, range.length, &content) == false) return false;
+            return evbuffer_add(outbuf, content.data(), content.size()) == 0;
+        }
 
-        // 获取所有文件的存储信息
-        std::vector<StorageInfo> infos;
-        data_->GetAll(&infos);
+        CachedSegment *cached = new CachedSegment;
+        cached->key = info.storage_path_ + "-" + std::to_string(info.mtime_);
+        auto fill = [&info, deep_file](const std::string &path) {
+            REQUEST_LOG("uncompressing:%s", info.storage_path_.c_str());
+            return deep_file->DecodeTo(path);
+        };
+        if (cache_->Acquire(cached->key, size, fill, &cached->path) == false) {
+            delete cached;
+            return false;
+        }
+        REQUEST_LOG("decompress cache hits:%llu misses:%llu", (unsigned long long)cache_->Hits(),
+                    (unsigned long long)cache_->Misses());
+        int fd = open(cached->path.c_str(), O_RDONLY);
+        evbuffer_file_segment *segment = nullptr;
+        if (fd == -1 || (segment = evbuffer_file_segment_new(fd, 0, size, EVBUF_FS_CLOSE_ON_FREE)) == nullptr) {
+            wwlog::GetLogger("asynclogger")->Error("open file error: %s -- %s", cached->path.c_str(), strerror(errno));
+            if (fd != -1) close(fd);
+            ReleaseCached(nullptr, 0, cached);
+            return false;
+        }
+        // 段的引用随 outbuf 一起传递，数据发完或连接断开时回调释放缓存引用
+        evbuffer_file_segment_add_cleanup_cb(segment, ReleaseCached, cached);
+        int ret = evbuffer_add_file_segment(outbuf, segment, range.start, range.length);
+        evbuffer_file_segment_free(segment);
+        return ret == 0;
+    }
+    static void ReleaseCached(evbuffer_file_segment const *segment, int flags, void *arg)
+    {
+        CachedSegment *cached = (CachedSegment *)arg;
+        cache_->Release(cached->key, cached->path);
+        delete cached;
+    }
+    // GET /api/files?sort=name|size|mtime&order=asc|desc&prefix=&limit=&offset=&cursor=
+    // 每页最多 kMaxListLimit 条，next_cursor 是下一页的游标，没有下一页时为 null
+    static void ListFiles(struct evhttp_request *request, void *arg)
+    {
+        MetricTimer timer(kHistListFiles);
+        evkeyvalq params;
+        const char *query_str = evhttp_uri_get_query(evhttp_request_get_evhttp_uri(request));
+        if (evhttp_parse_query_str(query_str ? query_str : "", &params) == -1) {
+            evhttp_send_error(request, HTTP_BADREQUEST, "Bad Query");
+            return;
+        }
+        auto param = [&params](const char *name, const char *def) {
+            const char *value = evhttp_find_header(&params, name);
+            return std::string(value ? value : def);
+        };
+        ListQuery query;
+        std::string sort = param("sort", "mtime");
+        query.order = sort == "name" ? kSortByName : sort == "size" ? kSortBySize : kSortByMtime;
+        query.desc = param("order", query.order == kSortByName ? "asc" : "desc") == "desc";
+        query.prefix = param("prefix", "");
+        query.offset = strtoull(param("offset", "0").c_str(), nullptr, 10);
+        query.limit = strtoull(param("limit", "100").c_str(), nullptr, 10);
+        if (query.limit > kMaxListLimit) query.limit = kMaxListLimit;
+        std::string cursor = param("cursor", "");
+        evhttp_clear_headers(&params);
+        if (sort != "mtime" && sort != "name" && sort != "size") {
+            evhttp_send_error(request, HTTP_BADREQUEST, "Bad Sort");
+            return;
+        }
+        // limit 为 0 或者不是数字时一页都取不到，也就没有下一页的游标
+        if (query.limit == 0) {
+            evhttp_send_error(request, HTTP_BADREQUEST, "Bad Limit");
+            return;
+        }
+        // 游标是 base64url(排序键 \n url)，url 里不会有换行
+        query.has_cursor = !cursor.empty();
+        if (query.has_cursor) {
+            std::string decoded;
+            try {
+                decoded = base64_decode(cursor);
+            } catch (const std::exception &e) {
+                // 不是合法的 base64，下面按找不到分隔符处理
+            }
+            size_t sep = decoded.rfind('\n');
+            if (sep == std::string::npos) {
+                evhttp_send_error(request, HTTP_BADREQUEST, "Bad Cursor");
+                return;
+            }
+            query.cursor_key = decoded.substr(0, sep);
+            query.cursor_url = decoded.substr(sep + 1);
+            query.offset = 0;
+        }
 
-        // 读取 HTML 模板文件
-        std::ifstream template_file("www/template.html");
-        std::string template_content((std::istreambuf_iterator<char>(template_file)), std::istreambuf_iterator<char>());
+        std::vector<StorageTable::Entry> page;
+        bool more = data_->List(query, &page);
 
-        // 替换占位符
-        template_content =
-            std::regex_replace(template_content, std::regex("\\{\\{FILE_LIST\\}\\}"), GenerateModernFileList(infos));
-        template_content = std::regex_replace(template_content, std::regex("\\{\\{BACKEND_URL\\}\\}"),
-                                              "http://" + wwstorage::Config::GetInstance()->GetServerIp() + ":" +
-                                                  std::to_string(wwstorage::Config::GetInstance()->GetServerPort()));
-        // 获取请求的输出 evbuffer
         struct evbuffer *buffer = evhttp_request_get_output_buffer(request);
-        auto response_body = template_content;
-        evbuffer_add(buffer, (const void *)response_body.c_str(), response_body.size());
+        JsonStream json(buffer);
+        json.BeginObject();
+        json.Key("total").Uint(data_->Size());
+        json.Key("count").Uint(page.size());
+        json.Key("files").BeginArray();
+        std::string low_dir = Config::GetInstance()->GetLowStorageDir();
+        for (auto &entry : page) {
+            json.BeginObject();
+            json.Key("name").String(File(entry->storage_path_).FileName());
+            json.Key("url").String(entry->url_);
+            json.Key("storage").String(entry->storage_path_.find(low_dir) == std::string::npos ? "deep" : "low");
+            json.Key("size").Uint(entry->fsize_);
+            json.Key("mtime").Int(entry->mtime_);
+            json.Key("atime").Int(entry->atime_);
+            json.EndObject();
+        }
+        json.EndArray();
+        json.Key("next_cursor");
+        if (more && !page.empty()) {
+            const StorageInfo &last = *page.back();
+            json.String(base64_encode(StorageTable::SortKey(last, query.order) + "\n" + last.url_, true));
+        } else {
+            json.Null();
+        }
+        json.EndObject();
+        evhttp_add_header(request->output_headers, "Content-Type", "application/json; charset=UTF-8");
+        evhttp_send_reply(request, HTTP_OK, "OK", buffer);
+    }
+    // GET /api/codecs?files=&sample_kb=&slow=1，配置了 codec_advisor_api 才开放。
+    // 抽样测量各编码并给出三种取舍下推荐的 bundle_format；测量在 codec 线程池里跑，同一时间只允许一个
+    static void AdviseCodecs(struct evhttp_request *request, void *arg)
+    {
+        static std::atomic<bool> running(false);
+        Config *config = Config::GetInstance();
+        if (config->GetCodecAdvisorApi() == false) {
+            evhttp_send_error(request, HTTP_NOTFOUND, "Not Found");
+            return;
+        }
+        evkeyvalq params;
+        const char *query_str = evhttp_uri_get_query(evhttp_request_get_evhttp_uri(request));
+        if (evhttp_parse_query_str(query_str ? query_str : "", &params) == -1) {
+            evhttp_send_error(request, HTTP_BADREQUEST, "Bad Query");
+            return;
+        }
+        auto param = [&params](const char *name, const char *def) {
+            const char *value = evhttp_find_header(&params, name);
+            return std::string(value ? value : def);
+        };
+        size_t files = strtoull(param("files", "32").c_str(), nullptr, 10);
+        if (files > kMaxAdviseFiles) files = kMaxAdviseFiles;
+        size_t sample_kb = strtoull(param("sample_kb", "1024").c_str(), nullptr, 10);
+        if (sample_kb > kMaxAdviseSampleKb) sample_kb = kMaxAdviseSampleKb;
+        bool slow = param("slow", "0") == "1";
+        evhttp_clear_headers(&params);
+        if (running.exchange(true)) {
+            evhttp_send_reply(request, HTTP_SERVUNAVAIL, "Codec Advisor Busy", nullptr);
+            return;
+        }
+
+        auto scores = std::make_shared<std::vector<CodecScore>>();
+        auto sampled = std::make_shared<size_t>(0);
+        std::string low_dir = config->GetLowStorageDir(), deep_dir = config->GetDeepStorageDir();
+        auto work = [=]() {
+            CodecAdvisor advisor(low_dir, deep_dir, files, sample_kb * 1024);
+            *sampled = advisor.Run(slow, scores.get());
+        };
+        auto done = [=]() {
+            running = false;
+            struct evbuffer *buffer = evhttp_request_get_output_buffer(request);
+            JsonStream json(buffer);
+            json.BeginObject();
+            json.Key("files").Uint(*sampled);
+            json.Key("raw_bytes").Uint(scores->empty() ? 0 : scores->front().raw_bytes);
+            json.Key("bundle_format").Int(Config::GetInstance()->GetBundleFormat());
+            json.Key("codecs").BeginArray();
+            for (auto &score : *scores) {
+                json.BeginObject();
+                json.Key("id").Uint(score.codec);
+                json.Key("name").String(bundle::name_of(score.codec));
+                json.Key("pass").Bool(score.pass);
+                json.Key("ratio").Double(score.Ratio());
+                json.Key("compress_mb_s").Double(score.EncMBps());
+                json.Key("decompress_mb_s").Double(score.DecMBps());
+                json.EndObject();
+            }
+            json.EndArray();
+            json.Key("recommend").BeginObject();
+            for (const char *target : {"speed", "balanced", "ratio"}) {
+                unsigned codec = CodecAdvisor::Recommend(*scores, CodecBudget::ForTarget(ParseCodecTarget(target)),
+                                                         Config::GetInstance()->GetCodecRawRatio());
+                json.Key(target).BeginObject();
+                json.Key("id").Uint(codec);
+                json.Key("name").String(bundle::name_of(codec));
+                json.EndObject();
+            }
+            json.EndObject();
+            json.EndObject();
+            evhttp_add_header(request->output_headers, "Content-Type", "application/json; charset=UTF-8");
+            evhttp_send_reply(request, HTTP_OK, "OK", buffer);
+        };
+        if (codec_pool_->Submit(BaseOf(request), work, done) == false) {
+            running = false;
+            evhttp_send_reply(request, HTTP_SERVUNAVAIL, "Service Unavailable", nullptr);
+        }
+    }
+    // 各线程最近的 span，Chrome trace JSON；trace_spans 为 0 时没有
+    static void ShowTraces(struct evhttp_request *request, void *arg)
+    {
+        if (Tracer::Instance().Enabled() == false) {
+            evhttp_send_error(request, HTTP_NOTFOUND, "Not Found");
+            return;
+        }
+        struct evbuffer *buffer = evhttp_request_get_output_buffer(request);
+        Tracer::Instance().Render(buffer);
+        evhttp_add_header(request->output_headers, "Content-Type", "application/json; charset=UTF-8");
+        evhttp_send_reply(request, HTTP_OK, "OK", buffer);
+    }
+    static void DumpTraces(evutil_socket_t sig, short events, void *arg)
+    {
+        Tracer::Instance().Dump(Config::GetInstance()->GetTraceDumpPath());
+    }
+    static void ListShow(struct evhttp_request *request, void *arg)
+    {
+        MetricTimer timer(kHistListShow);
+        REQUEST_LOG("ListShow()");
+
+        // 模板只在文件变化时重新加载，文件列表只在索引变化后重新生成，最近修改的排在前面
+        Config *config = Config::GetInstance();
+        int upload_port = config->GetUploadStreamPort();
+        if (upload_port <= 0) upload_port = config->GetServerPort();
+        static ListPage page("www/template.html", "{{FILE_LIST}}",
+                             {{"{{BACKEND_URL}}", "http://" + config->GetServerIp() + ":" +
+                                                      std::to_string(config->GetServerPort())},
+                              {"{{UPLOAD_URL}}", "http://" + config->GetServerIp() + ":" + std::to_string(upload_port)}});
+        auto render = []() {
+            std::vector<StorageInfo> infos;
+            data_->GetAllSorted(kSortByMtime, true, &infos);
+            return GenerateModernFileList(infos);
+        };
+        std::vector<ListPage::Piece> pieces;
+        if (page.Get(data_->Generation(), render, &pieces) == false) {
+            evhttp_send_reply(request, HTTP_INTERNAL, NULL, NULL);
+            return;
+        }
+
+        // 各段都是共享的不可变缓冲区，直接引用，发送完再释放引用
+        struct evbuffer *buffer = evhttp_request_get_output_buffer(request);
+        for (auto &piece : pieces) {
+            evbuffer_add_reference(buffer, piece->data(), piece->size(), ReleasePiece, new ListPage::Piece(piece));
+        }
         evhttp_add_header(request->output_headers, "Content-Type", "text/html; charset=UTF-8");
         evhttp_send_reply(request, HTTP_OK, "OK", buffer);
-        wwlog::GetLogger("asynclogger")->Info("ListShow() finish.");
+        REQUEST_LOG("ListShow() finish.");
+    }
+    // Prometheus 文本格式：请求/阶段的计数和直方图，加上各模块现读的统计
+    static void ShowMetrics(struct evhttp_request *request, void *arg)
+    {
+        evbuffer *out = evhttp_request_get_output_buffer(request);
+        Metrics::Instance().Render(out);
+        Metrics::Gauge(out, "filerelay_index_entries", "Files in the storage index.", data_->Size());
+        Metrics::Gauge(out, "filerelay_codec_queue_depth", "Jobs waiting in the codec pool.",
+                       codec_pool_->QueueDepth());
+        Metrics::Gauge(out, "filerelay_codec_running", "Jobs running in the codec pool.", codec_pool_->Running());
+        Metrics::Counter(out, "filerelay_codec_submitted_total", "Jobs submitted to the codec pool.",
+                         codec_pool_->Submitted());
+        Metrics::Counter(out, "filerelay_codec_rejected_total", "Jobs rejected because the codec queue was full.",
+                         codec_pool_->Rejected());
+        Metrics::Counter(out, "filerelay_decompress_cache_hits_total", "Decompress cache hits.", cache_->Hits());
+        Metrics::Counter(out, "filerelay_decompress_cache_misses_total", "Decompress cache misses.", cache_->Misses());
+        Metrics::Gauge(out, "filerelay_decompress_cache_bytes", "Bytes held by the decompress cache.", cache_->Used());
+        if (file_cache_) {
+            Metrics::Counter(out, "filerelay_file_cache_hits_total", "File descriptor cache hits.",
+                             file_cache_->Hits());
+            Metrics::Counter(out, "filerelay_file_cache_misses_total", "File descriptor cache misses.",
+                             file_cache_->Misses());
+            Metrics::Counter(out, "filerelay_file_cache_evictions_total", "File descriptor cache evictions.",
+                             file_cache_->Evictions());
+            Metrics::Counter(out, "filerelay_file_cache_invalidations_total", "File descriptor cache invalidations.",
+                             file_cache_->Invalidations());
+            Metrics::Gauge(out, "filerelay_file_cache_entries", "Open files held by the cache.", file_cache_->Size());
+        }
+        if (blob_store_) {
+            Metrics::Gauge(out, "filerelay_blobs", "Blobs in the content-addressed store.", blob_store_->Blobs());
+            Metrics::Counter(out, "filerelay_blob_dedup_hits_total", "Uploads stored as a link to an existing blob.",
+                             blob_store_->DedupHits());
+            Metrics::Counter(out, "filerelay_blob_bytes_saved_total", "Upload bytes not written thanks to dedup.",
+                             blob_store_->BytesSaved());
+        }
+        if (chunk_store_) {
+            Metrics::Gauge(out, "filerelay_chunks", "Chunks in the chunk store.", chunk_store_->Chunks());
+            Metrics::Counter(out, "filerelay_chunk_dedup_total", "Chunk writes that found an existing chunk.",
+                             chunk_store_->DedupChunks());
+            Metrics::Gauge(out, "filerelay_chunk_raw_bytes", "Raw bytes of the stored chunks.",
+                           chunk_store_->RawBytes());
+            Metrics::Gauge(out, "filerelay_chunk_stored_bytes", "On-disk bytes of the stored chunks.",
+                           chunk_store_->StoredBytes());
+        }
+        if (tier_manager_) {
+            Metrics::Counter(out, "filerelay_tier_promoted_total", "Deep files moved to low storage.",
+                             tier_manager_->Promoted());
+            Metrics::Counter(out, "filerelay_tier_demoted_total", "Low files moved to deep storage.",
+                             tier_manager_->Demoted());
+            Metrics::Counter(out, "filerelay_tier_moved_bytes_total", "Bytes moved between tiers.",
+                             tier_manager_->MovedBytes());
+        }
+        evhttp_add_header(request->output_headers, "Content-Type", "text/plain; version=0.0.4");
+        evhttp_send_reply(request, HTTP_OK, "OK", NULL);
     }
+    static void ReleasePiece(const void *data, size_t len, void *arg) { delete (ListPage::Piece *)arg; }
     static std::string GetETag(const StorageInfo &info)
     {
         // 自定义 ETag：filename-fsize-mtime
@@ -330,11 +1104,18 @@ private:
         ss << std::fixed << std::setprecision(2) << size << " " << units[unit_index];
         return ss.str();
     }
-    static std::string TimeToString(time_t t) { return std::ctime(&t); }
+    static std::string TimeToString(time_t t)
+    {
+        // ctime 返回静态缓冲区，多个工作线程同时渲染列表时要用可重入版本
+        char buf[32];
+        return ctime_r(&t, buf);
+    }
 
 private:
     uint16_t server_port_;
     std::string server_ip_;
     std::string download_prefix_;
+    int upload_stream_port_;
+    int worker_threads_;
 };
 }  // namespace wwstorage
\ No newline at end of file
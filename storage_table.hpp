@@ -0,0 +1,269 @@
+#pragma once
+
+#include <pthread.h>
+
+#include <iterator>
+#include <map>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "config.hpp"
+#include "trace.hpp"
+
+namespace wwstorage {
+
+typedef struct StorageInfo {
+    time_t mtime_;
+    time_t atime_;
+    size_t fsize_;
+    std::string storage_path_;
+    std::string url_;
+
+    bool NewStorageInfo(const std::string &storage_path)
+    {
+        File info_file(storage_path);
+        if (!info_file.Exists()) {
+            wwlog::GetLogger("asynclogger")->Info("info file not exists.");
+            return false;
+        }
+        mtime_ = info_file.LastModifyTime();
+        atime_ = info_file.LastAccessTime();
+        fsize_ = info_file.Size();
+        storage_path_ = storage_path;
+        wwstorage::Config *config = wwstorage::Config::GetInstance();
+        url_ = config->GetDownloadPrefix() + info_file.FileName();
+        REQUEST_LOG("download_url:%s, mtime:%lld, atime:%lld, fsize:%llu", url_.c_str(), (long long)mtime_,
+                    (long long)atime_, (unsigned long long)fsize_);
+        return true;
+    }
+} StorageInfo;
+
+enum SortOrder { kSortByMtime, kSortByName, kSortBySize };
+
+// 分页查询条件。有 cursor 时从游标之后继续（O(log n) 定位），否则跳过 offset 条（O(offset)）
+struct ListQuery {
+    SortOrder order;
+    bool desc;
+    std::string prefix;  // 文件名前缀，为空表示不过滤
+    size_t offset;
+    size_t limit;
+    bool has_cursor;
+    std::string cursor_key;  // 上一页最后一条的排序键和 url
+    std::string cursor_url;
+};
+
+// 按 url 哈希分片的存储信息表，每个分片一把读写锁，
+// 下载时按 url 查询只会和同一分片的写操作竞争。
+// 条目是不可变的 shared_ptr，二级索引直接引用条目，由 index_lock_ 保护；
+// 写操作的加锁顺序固定为 index_lock_ -> 分片锁，读操作只拿其中一把
+class StorageTable {
+public:
+    typedef std::shared_ptr<const StorageInfo> Entry;
+
+    explicit StorageTable(size_t shard_count)
+        : shard_count_(shard_count > 0 ? shard_count : 1), shards_(new Shard[shard_count_])
+    {
+        pthread_rwlock_init(&index_lock_, NULL);
+    }
+    ~StorageTable() { pthread_rwlock_destroy(&index_lock_); }
+    StorageTable(const StorageTable &) = delete;
+    StorageTable &operator=(const StorageTable &) = delete;
+
+    void Reserve(size_t count)
+    {
+        for (size_t i = 0; i < shard_count_; i++) {
+            Shard &shard = shards_[i];
+            pthread_rwlock_wrlock(&shard.lock);
+            shard.table.reserve(count / shard_count_ + 1);
+            pthread_rwlock_unlock(&shard.lock);
+        }
+        pthread_rwlock_wrlock(&index_lock_);
+        path_index_.reserve(count);
+        pthread_rwlock_unlock(&index_lock_);
+    }
+    // 主表和二级索引在两把锁都持有时一起更新，对读者是原子的
+    void Put(const StorageInfo &info)
+    {
+        Entry entry = std::make_shared<const StorageInfo>(info);
+        Shard &shard = ShardOf(info.url_);
+        pthread_rwlock_wrlock(&index_lock_);
+        pthread_rwlock_wrlock(&shard.lock);
+        Entry &slot = shard.table[info.url_];
+        Entry old = slot;
+        slot = entry;
+        pthread_rwlock_unlock(&shard.lock);
+
+        if (old != nullptr) {
+            path_index_.erase(old->storage_path_);
+            by_mtime_.erase({old->mtime_, old->url_});
+            by_name_.erase({File(old->storage_path_).FileName(), old->url_});
+            by_size_.erase({old->fsize_, old->url_});
+        }
+        path_index_[entry->storage_path_] = entry;
+        by_mtime_.emplace(std::make_pair(entry->mtime_, entry->url_), entry);
+        by_name_.emplace(std::make_pair(File(entry->storage_path_).FileName(), entry->url_), entry);
+        by_size_.emplace(std::make_pair(entry->fsize_, entry->url_), entry);
+        pthread_rwlock_unlock(&index_lock_);
+    }
+    bool GetByUrl(const std::string &url, StorageInfo *info)
+    {
+        Shard &shard = ShardOf(url);
+        pthread_rwlock_rdlock(&shard.lock);
+        auto it = shard.table.find(url);
+        if (it == shard.table.end()) {
+            pthread_rwlock_unlock(&shard.lock);
+            return false;
+        }
+        *info = *it->second;
+        pthread_rwlock_unlock(&shard.lock);
+        return true;
+    }
+    bool GetByStoragePath(const std::string &storage_path, StorageInfo *info)
+    {
+        pthread_rwlock_rdlock(&index_lock_);
+        auto it = path_index_.find(storage_path);
+        if (it == path_index_.end()) {
+            pthread_rwlock_unlock(&index_lock_);
+            return false;
+        }
+        *info = *it->second;
+        pthread_rwlock_unlock(&index_lock_);
+        return true;
+    }
+    void GetAll(std::vector<StorageInfo> *array)
+    {
+        for (size_t i = 0; i < shard_count_; i++) {
+            Shard &shard = shards_[i];
+            pthread_rwlock_rdlock(&shard.lock);
+            for (auto &e : shard.table) array->emplace_back(*e.second);
+            pthread_rwlock_unlock(&shard.lock);
+        }
+    }
+    void GetAllSorted(SortOrder order, bool desc, std::vector<StorageInfo> *array)
+    {
+        pthread_rwlock_rdlock(&index_lock_);
+        array->reserve(array->size() + path_index_.size());
+        if (order == kSortByMtime) {
+            AppendInOrder(by_mtime_, desc, array);
+        } else if (order == kSortBySize) {
+            AppendInOrder(by_size_, desc, array);
+        } else {
+            AppendInOrder(by_name_, desc, array);
+        }
+        pthread_rwlock_unlock(&index_lock_);
+    }
+    // 按有序索引取一页，只复制这一页条目的 shared_ptr，返回后面是否还有符合条件的条目。
+    // 按名字排序时前缀过滤直接在索引上定位，其他排序需要逐条检查文件名
+    bool List(const ListQuery &query, std::vector<Entry> *page)
+    {
+        bool more;
+        pthread_rwlock_rdlock(&index_lock_);
+        if (query.order == kSortByMtime) {
+            more = ListIndex(by_mtime_, {(time_t)strtoll(query.cursor_key.c_str(), nullptr, 10), query.cursor_url},
+                             query, page);
+        } else if (query.order == kSortBySize) {
+            more = ListIndex(by_size_, {(size_t)strtoull(query.cursor_key.c_str(), nullptr, 10), query.cursor_url},
+                             query, page);
+        } else {
+            more = ListIndex(by_name_, {query.cursor_key, query.cursor_url}, query, page);
+        }
+        pthread_rwlock_unlock(&index_lock_);
+        return more;
+    }
+    // 条目在 order 下的排序键，和 url 一起组成游标
+    static std::string SortKey(const StorageInfo &info, SortOrder order)
+    {
+        if (order == kSortByMtime) return std::to_string(info.mtime_);
+        if (order == kSortBySize) return std::to_string(info.fsize_);
+        return File(info.storage_path_).FileName();
+    }
+    size_t Size()
+    {
+        size_t size = 0;
+        for (size_t i = 0; i < shard_count_; i++) {
+            Shard &shard = shards_[i];
+            pthread_rwlock_rdlock(&shard.lock);
+            size += shard.table.size();
+            pthread_rwlock_unlock(&shard.lock);
+        }
+        return size;
+    }
+
+private:
+    // 按缓存行对齐，避免相邻分片的锁互相伪共享
+    struct alignas(64) Shard {
+        Shard() { pthread_rwlock_init(&lock, NULL); }
+        ~Shard() { pthread_rwlock_destroy(&lock); }
+        pthread_rwlock_t lock;
+        std::unordered_map<std::string, Entry> table;
+    };
+
+    Shard &ShardOf(const std::string &url) { return shards_[std::hash<std::string>()(url) % shard_count_]; }
+
+    // 调用方需持有 index_lock_
+    template <typename Index>
+    void AppendInOrder(const Index &index, bool desc, std::vector<StorageInfo> *array)
+    {
+        if (desc) {
+            for (auto it = index.rbegin(); it != index.rend(); ++it) array->emplace_back(*it->second);
+        } else {
+            for (auto it = index.begin(); it != index.end(); ++it) array->emplace_back(*it->second);
+        }
+    }
+
+    // 调用方需持有 index_lock_
+    template <typename Index>
+    bool ListIndex(const Index &index, const typename Index::key_type &cursor, const ListQuery &query,
+                   std::vector<Entry> *page)
+    {
+        constexpr bool by_name = std::is_same<typename Index::key_type::first_type, std::string>::value;
+        size_t skip = query.offset;
+        bool more = false;
+        // 返回 false 表示停止遍历
+        auto visit = [&](const typename Index::value_type &item) {
+            if (!query.prefix.empty()) {
+                std::string name = File(item.second->storage_path_).FileName();
+                int cmp = name.compare(0, query.prefix.size(), query.prefix);
+                // 按名字有序时，越过前缀的范围后不会再有匹配的条目
+                if (by_name && cmp != 0) return !(query.desc ? cmp < 0 : cmp > 0);
+                if (cmp != 0) return true;
+            }
+            if (skip > 0) {
+                skip--;
+                return true;
+            }
+            if (page->size() == query.limit) {
+                more = true;
+                return false;
+            }
+            page->push_back(item.second);
+            return true;
+        };
+        if (query.desc) {
+            auto it = query.has_cursor ? std::make_reverse_iterator(index.lower_bound(cursor)) : index.rbegin();
+            while (it != index.rend() && visit(*it)) ++it;
+        } else {
+            auto it = query.has_cursor ? index.upper_bound(cursor) : index.begin();
+            if constexpr (by_name) {
+                // 按名字升序且有前缀时直接跳到前缀开始的位置
+                typename Index::key_type start(query.prefix, "");
+                if (!query.prefix.empty() && (it == index.end() || it->first < start)) it = index.lower_bound(start);
+            }
+            while (it != index.end() && visit(*it)) ++it;
+        }
+        return more;
+    }
+
+private:
+    size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+    pthread_rwlock_t index_lock_;
+    std::unordered_map<std::string, Entry> path_index_;
+    std::map<std::pair<time_t, std::string>, Entry> by_mtime_;      // (mtime, url)
+    std::map<std::pair<std::string, std::string>, Entry> by_name_;  // (file name, url)
+    std::map<std::pair<size_t, std::string>, Entry> by_size_;       // (fsize, url)
+};
+
+}  // namespace wwstorage
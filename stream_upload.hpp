@@ -0,0 +1,295 @@
+#pragma once
+
+#include <event2/buffer.h>
+#include <event2/bufferevent.h>
+#include <event2/event.h>
+#include <event2/listener.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+
+#include "metrics.hpp"
+#include "sha256.hpp"
+#include "utils.hpp"
+
+namespace wwstorage {
+
+// 流式上传请求：请求体已经完整写入 tmp_path
+struct StreamUpload {
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> headers;  // 头部名统一转成小写
+    std::string tmp_path;
+    uint64_t length;
+    std::string sha256;  // 请求体的摘要，接收时边写边算
+    uint64_t start_us;   // 头部读完的时间，Metrics::NowMicros
+    TraceContext trace;
+
+    std::string Header(const std::string &name) const
+    {
+        auto it = headers.find(name);
+        return it == headers.end() ? "" : it->second;
+    }
+};
+
+// 回复上传结果，必须在连接所属 base 的线程里调用且只调用一次；
+// 状态码为 200 时临时文件归 handler 处理，否则由 StreamUploadServer 删除
+typedef std::function<void(int status)> StreamUploadReply;
+// 处理接收完成的上传，可以把工作交给其他线程，完成后再调用 reply
+typedef std::function<void(event_base *base, const StreamUpload &upload, const StreamUploadReply &reply)>
+    StreamUploadHandler;
+
+// evhttp 要等整个请求体缓存在内存里才回调，大文件上传会占用数倍于文件大小的内存。
+// 这里在 bufferevent 层直接处理 POST /upload：读完头部后把请求体边收边写进临时文件，
+// 读缓冲区受高水位限制，单个上传占用的内存不超过 buffer_size
+class StreamUploadServer {
+public:
+    StreamUploadServer(const std::string &tmp_dir, size_t buffer_size, const StreamUploadHandler &handler)
+        : tmp_dir_(tmp_dir), buffer_size_(buffer_size), handler_(handler), listener_(nullptr)
+    {
+    }
+    ~StreamUploadServer()
+    {
+        if (listener_) evconnlistener_free(listener_);
+    }
+
+    // 端口带 SO_REUSEPORT，每个工作线程可以各自监听同一个端口
+    bool Start(event_base *base, uint16_t port)
+    {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        unsigned flags = LEV_OPT_REUSEABLE | LEV_OPT_REUSEABLE_PORT | LEV_OPT_CLOSE_ON_FREE;
+        listener_ = evconnlistener_new_bind(base, AcceptCb, this, flags, -1, (sockaddr *)&addr, sizeof(addr));
+        if (listener_ == nullptr) {
+            wwlog::GetLogger("asynclogger")->Fatal("stream upload bind port %u error!", port);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    enum State { kReadHeaders, kReadBody, kProcessing, kReplied };
+    static const size_t kMaxHeaderSize = 64 * 1024;
+
+    struct Connection {
+        StreamUploadServer *server;
+        bufferevent *bev;
+        State state;
+        StreamUpload upload;
+        uint64_t remaining;
+        int fd;
+        bool closed;  // handler 处理期间客户端断开
+        Sha256 sha;
+    };
+
+    static void AcceptCb(evconnlistener *listener, evutil_socket_t fd, sockaddr *addr, int len, void *arg)
+    {
+        StreamUploadServer *server = (StreamUploadServer *)arg;
+        event_base *base = evconnlistener_get_base(listener);
+        bufferevent *bev = bufferevent_socket_new(base, fd, BEV_OPT_CLOSE_ON_FREE);
+        if (bev == nullptr) {
+            evutil_closesocket(fd);
+            return;
+        }
+        Metrics::Instance().Add(kCounterConnections);
+        Connection *conn = new Connection();
+        conn->server = server;
+        conn->bev = bev;
+        conn->state = kReadHeaders;
+        conn->remaining = 0;
+        conn->fd = -1;
+        conn->closed = false;
+        // 输入缓冲区超过高水位就暂停读 socket，直到 ReadCb 把数据写进文件
+        bufferevent_setwatermark(bev, EV_READ, 0, server->buffer_size_);
+        bufferevent_setcb(bev, ReadCb, nullptr, EventCb, conn);
+        bufferevent_enable(bev, EV_READ | EV_WRITE);
+    }
+    static void ReadCb(bufferevent *bev, void *arg)
+    {
+        Connection *conn = (Connection *)arg;
+        evbuffer *input = bufferevent_get_input(bev);
+        if (conn->state == kReadHeaders && !ReadHeaders(conn, input)) return;
+        if (conn->state == kReadBody) ReadBody(conn, input);
+        if (conn->state == kReplied) evbuffer_drain(input, evbuffer_get_length(input));
+    }
+    // 头部读完返回 true
+    static bool ReadHeaders(Connection *conn, evbuffer *input)
+    {
+        size_t n = 0;
+        char *line;
+        while ((line = evbuffer_readln(input, &n, EVBUFFER_EOL_CRLF)) != nullptr) {
+            std::string text(line, n);
+            free(line);
+            if (conn->upload.method.empty()) {
+                // 请求行：METHOD PATH VERSION
+                size_t sp1 = text.find(' '), sp2 = text.rfind(' ');
+                if (sp1 == std::string::npos || sp2 == sp1) {
+                    Reply(conn, 400, "Bad Request");
+                    return false;
+                }
+                conn->upload.method = text.substr(0, sp1);
+                conn->upload.path = UrlDecode(text.substr(sp1 + 1, sp2 - sp1 - 1));
+                continue;
+            }
+            if (text.empty()) return BeginBody(conn);
+            size_t colon = text.find(':');
+            if (colon == std::string::npos) continue;
+            std::string name = text.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            size_t value = text.find_first_not_of(" \t", colon + 1);
+            conn->upload.headers[name] = value == std::string::npos ? "" : text.substr(value);
+        }
+        if (evbuffer_get_length(input) > kMaxHeaderSize) Reply(conn, 431, "Request Header Fields Too Large");
+        return false;
+    }
+    static bool BeginBody(Connection *conn)
+    {
+        StreamUpload &upload = conn->upload;
+        if (upload.method == "OPTIONS") {
+            Reply(conn, 204, "");
+            return false;
+        }
+        if (upload.method != "POST" || upload.path.find("/upload") == std::string::npos) {
+            Reply(conn, 404, "Not Found");
+            return false;
+        }
+        if (upload.Header("content-length").empty()) {
+            Reply(conn, 411, "Length Required");
+            return false;
+        }
+        if (upload.Header("filename").empty() || upload.Header("storagetype").empty()) {
+            Reply(conn, 400, "Bad Request");
+            return false;
+        }
+        upload.length = strtoull(upload.Header("content-length").c_str(), nullptr, 10);
+        upload.start_us = Metrics::NowMicros();
+        upload.trace = Tracer::Instance().NewContext(upload.Header("x-debug-log") == "1");
+        if (upload.length == 0) {
+            Reply(conn, 400, "Bad Request");
+            return false;
+        }
+
+        File(conn->server->tmp_dir_).CreateDirectory();
+        std::string tmp_path = conn->server->tmp_dir_ + ".upload-XXXXXX";
+        conn->fd = mkstemp(&tmp_path[0]);
+        if (conn->fd == -1) {
+            wwlog::GetLogger("asynclogger")->Error("stream upload mkstemp error: %s", strerror(errno));
+            Reply(conn, 500, "Internal Server Error");
+            return false;
+        }
+        upload.tmp_path = tmp_path;
+        conn->remaining = upload.length;
+        conn->state = kReadBody;
+        return true;
+    }
+    static void ReadBody(Connection *conn, evbuffer *input)
+    {
+        // 直接用 evbuffer 内部的内存块 writev，写进文件的字节顺便喂给 sha256，数据不多拷贝一次
+        const int kMaxVecs = 16;
+        while (conn->remaining > 0 && evbuffer_get_length(input) > 0) {
+            size_t atmost = std::min<uint64_t>(conn->remaining, evbuffer_get_length(input));
+            evbuffer_iovec vecs[kMaxVecs];
+            int n = std::min(evbuffer_peek(input, atmost, nullptr, vecs, kMaxVecs), kMaxVecs);
+            struct iovec iov[kMaxVecs];
+            size_t left = atmost;
+            for (int i = 0; i < n; i++) {
+                iov[i].iov_base = vecs[i].iov_base;
+                iov[i].iov_len = std::min(vecs[i].iov_len, left);
+                left -= iov[i].iov_len;
+            }
+            ssize_t written = writev(conn->fd, iov, n);
+            if (written <= 0) {
+                wwlog::GetLogger("asynclogger")
+                    ->Error("stream upload write %s error: %s", conn->upload.tmp_path.c_str(), strerror(errno));
+                Reply(conn, 500, "Internal Server Error");
+                return;
+            }
+            size_t hashed = written;
+            for (int i = 0; i < n && hashed > 0; i++) {
+                size_t len = std::min(iov[i].iov_len, hashed);
+                conn->sha.Update(iov[i].iov_base, len);
+                hashed -= len;
+            }
+            evbuffer_drain(input, written);
+            conn->remaining -= written;
+        }
+        if (conn->remaining > 0) return;
+        conn->upload.sha256 = conn->sha.HexDigest();
+        TraceScope trace(conn->upload.trace);
+        Metrics::Instance().ObserveSince(kStageReceive, conn->upload.start_us);
+        Metrics::Instance().Add(kCounterUploadBytes, conn->upload.length);
+
+        close(conn->fd);
+        conn->fd = -1;
+        conn->state = kProcessing;
+        bufferevent_disable(conn->bev, EV_READ);
+        conn->server->handler_(bufferevent_get_base(conn->bev), conn->upload, [conn](int status) {
+            if (status == 200) conn->upload.tmp_path.clear();
+            if (conn->closed) return Free(conn);
+            Reply(conn, status, status == 200 ? "OK" : "Upload Failed");
+        });
+    }
+    // 回复后关闭连接，临时文件如果还在（失败的上传）一并删除
+    static void Reply(Connection *conn, int status, const std::string &body)
+    {
+        conn->state = kReplied;
+        Cleanup(conn);
+        evbuffer *output = bufferevent_get_output(conn->bev);
+        evbuffer_add_printf(output,
+                            "HTTP/1.1 %d %s\r\n"
+                            "Access-Control-Allow-Origin: *\r\n"
+                            "Access-Control-Allow-Methods: POST, OPTIONS\r\n"
+                            "Access-Control-Allow-Headers: FileName, StorageType, Content-Type\r\n"
+                            "Content-Length: %zu\r\n"
+                            "Connection: close\r\n\r\n",
+                            status, status < 300 ? "OK" : "Error", body.size());
+        evbuffer_add(output, body.c_str(), body.size());
+        bufferevent_setcb(conn->bev, nullptr, WriteDoneCb, EventCb, conn);
+    }
+    static void WriteDoneCb(bufferevent *bev, void *arg) { Free((Connection *)arg); }
+    static void EventCb(bufferevent *bev, short events, void *arg)
+    {
+        Connection *conn = (Connection *)arg;
+        if (events & (BEV_EVENT_EOF | BEV_EVENT_ERROR)) {
+            if (conn->state == kProcessing) {
+                // handler 还持有 conn，等它回复时再释放
+                conn->closed = true;
+                bufferevent_disable(bev, EV_READ | EV_WRITE);
+                return;
+            }
+            if (conn->state == kReadBody) {
+                wwlog::GetLogger("asynclogger")
+                    ->Info("stream upload aborted, %llu bytes missing.", (unsigned long long)conn->remaining);
+            }
+            Free(conn);
+        }
+    }
+    static void Cleanup(Connection *conn)
+    {
+        if (conn->fd != -1) close(conn->fd);
+        conn->fd = -1;
+        if (!conn->upload.tmp_path.empty()) remove(conn->upload.tmp_path.c_str());
+        conn->upload.tmp_path.clear();
+    }
+    static void Free(Connection *conn)
+    {
+        Cleanup(conn);
+        bufferevent_free(conn->bev);
+        delete conn;
+        Metrics::Instance().Add(kCounterConnections, -1);
+    }
+
+private:
+    std::string tmp_dir_;
+    size_t buffer_size_;
+    StreamUploadHandler handler_;
+    evconnlistener *listener_;
+};
+
+}  // namespace wwstorage
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+
+#include "data_manager.hpp"
+
+namespace wwstorage {
+
+struct TierPolicy {
+    int interval_sec;      // 两次扫描的间隔
+    int64_t cold_seconds;  // low 文件这么久没有访问就压缩进 deep
+    uint32_t hot_hits;     // deep 文件的访问热度达到这个值就解压到 low
+    uint64_t rate_bytes;   // 迁移每秒最多读写的字节数，0 表示不限
+};
+
+// 冷热分层：下载时 Touch 记录访问，后台线程定期扫描索引，把长期没人读的 low 文件压缩进 deep，
+// 把频繁下载的 deep 文件解压到 low。访问热度只在内存里，每轮扫描减半，反映的是最近几轮的访问频率；
+// 最后访问时间在扫描时写回条目的 atime_。
+// 迁移由 mover 完成（写好新文件并原子地替换索引条目，url 不变），旧文件留到下一轮扫描再删，
+// 让替换前已经查到旧路径的下载能正常完成
+class TierManager {
+public:
+    // 把 info 迁到另一层，成功时索引已经指向新文件
+    typedef std::function<bool(const StorageInfo &info, bool to_deep)> Mover;
+    // 删除迁走的旧文件，和 mover 一起处理 blob 仓库的引用
+    typedef std::function<void(const std::string &path)> Remover;
+
+    TierManager(DataManager *data, const std::string &low_dir, const TierPolicy &policy, const Mover &mover,
+                const Remover &remover)
+        : data_(data), low_dir_(low_dir), policy_(policy), mover_(mover), remover_(remover), stop_(false),
+          promoted_(0), demoted_(0), moved_bytes_(0)
+    {
+    }
+    ~TierManager() { Stop(); }
+
+    void Start() { worker_ = std::thread(&TierManager::Run, this); }
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+        if (worker_.joinable()) worker_.join();
+        // 退出时已经没有进行中的下载
+        RemoveRetired();
+    }
+    // 下载时调用，只动 url 所在分片的锁
+    void Touch(const std::string &url)
+    {
+        Shard &shard = shards_[std::hash<std::string>()(url) % kShards];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Access &access = shard.table[url];
+        access.hits++;
+        access.last = time(nullptr);
+    }
+
+    uint64_t Promoted() const { return promoted_; }
+    uint64_t Demoted() const { return demoted_; }
+    uint64_t MovedBytes() const { return moved_bytes_; }
+
+private:
+    static const size_t kShards = 16;
+    struct Access {
+        Access() : hits(0), last(0) {}
+        uint32_t hits;
+        time_t last;
+    };
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Access> table;
+    };
+    // 迁走的旧文件，删除前确认没有被新上传替换过
+    struct Retired {
+        std::string path;
+        ino_t ino;
+        int64_t mtime_ns;
+    };
+
+    void Run()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            cv_.wait_for(lock, std::chrono::seconds(policy_.interval_sec), [this]() { return stop_; });
+            if (stop_) break;
+            lock.unlock();
+            Scan();
+            lock.lock();
+        }
+    }
+    bool Stopping()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stop_;
+    }
+    void Scan()
+    {
+        RemoveRetired();
+        std::unordered_map<std::string, Access> accesses;
+        Decay(&accesses);
+        FlushAtime(accesses);
+
+        std::vector<StorageInfo> all;
+        data_->GetAll(&all);
+        time_t now = time(nullptr);
+        std::vector<std::pair<uint32_t, StorageInfo>> hot;
+        std::vector<StorageInfo> cold;
+        for (auto &info : all) {
+            bool low = info.storage_path_.find(low_dir_) != std::string::npos;
+            if (low && now - std::max(info.atime_, info.mtime_) >= policy_.cold_seconds) {
+                cold.push_back(info);
+                continue;
+            }
+            auto it = accesses.find(info.url_);
+            if (!low && it != accesses.end() && it->second.hits >= policy_.hot_hits) {
+                hot.emplace_back(it->second.hits, info);
+            }
+        }
+        // 先提升最热的，再压缩最冷的
+        std::sort(hot.begin(), hot.end(), [](const std::pair<uint32_t, StorageInfo> &a,
+                                             const std::pair<uint32_t, StorageInfo> &b) { return a.first > b.first; });
+        std::sort(cold.begin(), cold.end(), [](const StorageInfo &a, const StorageInfo &b) {
+            return std::max(a.atime_, a.mtime_) < std::max(b.atime_, b.mtime_);
+        });
+        wwlog::GetLogger("asynclogger")
+            ->Info("tier scan: %u hot deep files, %u cold low files", hot.size(), cold.size());
+
+        auto start = std::chrono::steady_clock::now();
+        uint64_t bytes = 0;
+        for (auto &item : hot) {
+            if (Stopping()) return;
+            bytes += Move(item.second, false);
+            Throttle(start, bytes);
+        }
+        for (auto &info : cold) {
+            if (Stopping()) return;
+            bytes += Move(info, true);
+            Throttle(start, bytes);
+        }
+    }
+    // 返回迁移读写的字节数（按 fsize_ 估算），失败返回 0
+    uint64_t Move(const StorageInfo &info, bool to_deep)
+    {
+        struct stat st;
+        if (stat(info.storage_path_.c_str(), &st) == -1) return 0;
+        if (mover_(info, to_deep) == false) return 0;
+        retired_.push_back({info.storage_path_, st.st_ino, MtimeNs(st)});
+        (to_deep ? demoted_ : promoted_)++;
+        moved_bytes_ += info.fsize_;
+        wwlog::GetLogger("asynclogger")
+            ->Info("tier %s: %s", to_deep ? "demote" : "promote", info.storage_path_.c_str());
+        return info.fsize_;
+    }
+    static int64_t MtimeNs(const struct stat &st)
+    {
+        return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    }
+    // 超过速率就睡到平均速率回到限制以内
+    void Throttle(std::chrono::steady_clock::time_point start, uint64_t bytes)
+    {
+        if (policy_.rate_bytes == 0) return;
+        auto due = start + std::chrono::milliseconds(bytes * 1000 / policy_.rate_bytes);
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait_until(lock, due, [this]() { return stop_; });
+    }
+    // 取出所有访问记录并把热度减半，减到 0 的记录删掉
+    void Decay(std::unordered_map<std::string, Access> *accesses)
+    {
+        for (size_t i = 0; i < kShards; i++) {
+            std::lock_guard<std::mutex> lock(shards_[i].mutex);
+            auto &table = shards_[i].table;
+            for (auto it = table.begin(); it != table.end();) {
+                accesses->emplace(it->first, it->second);
+                it->second.hits /= 2;
+                it = it->second.hits == 0 ? table.erase(it) : std::next(it);
+            }
+        }
+    }
+    void FlushAtime(const std::unordered_map<std::string, Access> &accesses)
+    {
+        for (auto &access : accesses) {
+            StorageInfo info;
+            if (data_->GetOneByURL(access.first, &info) == false || info.atime_ >= access.second.last) continue;
+            StorageInfo touched = info;
+            touched.atime_ = access.second.last;
+            data_->Replace(info, touched);
+        }
+    }
+    // 上一轮迁走的旧文件：已经没有条目引用、也没有被重新上传（inode 和 mtime 都没变）才删除
+    void RemoveRetired()
+    {
+        for (auto &retired : retired_) {
+            StorageInfo info;
+            struct stat st;
+            if (data_->GetOneByStoragePath(retired.path, &info)) continue;
+            if (stat(retired.path.c_str(), &st) == -1 || st.st_ino != retired.ino || MtimeNs(st) != retired.mtime_ns) {
+                continue;
+            }
+            remover_(retired.path);
+        }
+        retired_.clear();
+    }
+
+private:
+    DataManager *data_;
+    std::string low_dir_;
+    TierPolicy policy_;
+    Mover mover_;
+    Remover remover_;
+
+    std::mutex mutex_;  // 保护 stop_
+    std::condition_variable cv_;
+    bool stop_;
+    std::thread worker_;
+
+    Shard shards_[kShards];
+    std::vector<Retired> retired_;  // 只在扫描线程里访问
+
+    std::atomic<uint64_t> promoted_;
+    std::atomic<uint64_t> demoted_;
+    std::atomic<uint64_t> moved_bytes_;
+};
+
+}  // namespace wwstorage
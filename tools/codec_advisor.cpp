@@ -0,0 +1,66 @@
+// 编码选型工具：在服务的工作目录下运行，按 config.conf 找到 low/deep 目录，抽样测量 bundle 的各种编码，
+// 输出压缩率、压缩/解压速度，以及 speed/balanced/ratio 三种取舍下推荐的 bundle_format。
+// 只读存储目录，服务运行时也可以用
+// 用法: codec_advisor [files] [sample_kb] [slow]，默认抽 32 个文件、每个取开头 1024KB，slow 时也测很慢的编码
+#include "../codec_advisor.hpp"
+#include "../config.hpp"
+#include "../../LogSystem/utils.hpp"
+#include "../../LogSystem/manage.hpp"
+
+void log_system_module_init()
+{
+    std::shared_ptr<wwlog::LoggerBuilder> logger_builder(new wwlog::LoggerBuilder());
+    logger_builder->SetLoggerName("asynclogger");
+    logger_builder->AddLoggerFlush<wwlog::StdoutFlush>();
+    logger_builder->SetThreadPool(std::shared_ptr<ThreadPool>(new ThreadPool(1)));
+    wwlog::LoggerManager::GetInstance().AddLogger(logger_builder->Build());
+}
+
+int main(int argc, char *argv[])
+{
+    size_t files = argc > 1 ? strtoull(argv[1], nullptr, 10) : 32;
+    size_t sample_bytes = (argc > 2 ? strtoull(argv[2], nullptr, 10) : 1024) * 1024;
+    bool slow = argc > 3 && std::string(argv[3]) == "slow";
+    log_system_module_init();
+
+    wwstorage::Config *config = wwstorage::Config::GetInstance();
+    // 只用来定位块文件，不调用 Init：Init 会回收没有被引用的块，和运行中的服务同时做会删掉正在写的块
+    std::unique_ptr<wwstorage::ChunkStore> chunk_store;
+    if (!config->GetChunkDir().empty()) {
+        chunk_store.reset(new wwstorage::ChunkStore(config->GetChunkDir(), config->GetChunkAvgSize()));
+        wwstorage::DeepFile::SetChunkStore(chunk_store.get());
+    }
+
+    wwstorage::CodecAdvisor advisor(config->GetLowStorageDir(), config->GetDeepStorageDir(), files, sample_bytes);
+    std::vector<wwstorage::CodecScore> scores;
+    size_t sampled = advisor.Run(slow, &scores);
+    if (sampled == 0) {
+        fprintf(stderr, "no file sampled from %s and %s\n", config->GetLowStorageDir().c_str(),
+                config->GetDeepStorageDir().c_str());
+        return 1;
+    }
+
+    std::sort(scores.begin(), scores.end(), [](const wwstorage::CodecScore &a, const wwstorage::CodecScore &b) {
+        return a.packed_bytes < b.packed_bytes;
+    });
+    printf("%zu files, %.2f MB sampled\n", sampled, scores.front().raw_bytes / 1048576.0);
+    printf("%-4s %-10s %10s %14s %16s\n", "id", "codec", "packed/raw", "compress MB/s", "decompress MB/s");
+    for (auto &score : scores) {
+        if (!score.pass) {
+            printf("%-4u %-10s %10s\n", score.codec, bundle::name_of(score.codec), "FAIL");
+            continue;
+        }
+        printf("%-4u %-10s %10.3f %14.1f %16.1f\n", score.codec, bundle::name_of(score.codec), score.Ratio(),
+               score.EncMBps(), score.DecMBps());
+    }
+
+    int current = config->GetBundleFormat();
+    printf("current bundle_format: %d (%s)\n", current, bundle::name_of((unsigned)current));
+    for (const char *target : {"speed", "balanced", "ratio"}) {
+        wwstorage::CodecBudget budget = wwstorage::CodecBudget::ForTarget(wwstorage::ParseCodecTarget(target));
+        unsigned codec = wwstorage::CodecAdvisor::Recommend(scores, budget, config->GetCodecRawRatio());
+        printf("recommend %-8s (compress >= %g MB/s, decompress >= %g MB/s): \"bundle_format\": %u  # %s\n", target,
+               budget.min_enc_mb_s, budget.min_dec_mb_s, codec, bundle::name_of(codec));
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+// storage.data 格式转换工具：JSON 快照 <-> 二进制索引
+// 用法: index_convert <input> <output> [binary|json]，默认转成二进制
+#include "../data_manager.hpp"
+#include "../../LogSystem/utils.hpp"
+#include "../../LogSystem/manage.hpp"
+
+void log_system_module_init()
+{
+    std::shared_ptr<wwlog::LoggerBuilder> logger_builder(new wwlog::LoggerBuilder());
+    logger_builder->SetLoggerName("asynclogger");
+    logger_builder->AddLoggerFlush<wwlog::StdoutFlush>();
+    logger_builder->SetThreadPool(std::shared_ptr<ThreadPool>(new ThreadPool(1)));
+    wwlog::LoggerManager::GetInstance().AddLogger(logger_builder->Build());
+}
+
+bool LoadEntries(const std::string &input, std::vector<wwstorage::StorageInfo> *arr)
+{
+    if (wwstorage::IndexMap::IsIndexFile(input)) {
+        wwstorage::IndexMap index;
+        if (!index.Open(input)) return false;
+        for (size_t i = 0; i < index.Size(); i++) {
+            wwstorage::IndexEntry entry = index.Get(i);
+            wwstorage::StorageInfo info;
+            info.mtime_ = entry.mtime;
+            info.atime_ = entry.atime;
+            info.fsize_ = entry.fsize;
+            info.url_.assign(entry.url);
+            info.storage_path_.assign(entry.storage_path);
+            arr->push_back(info);
+        }
+        return true;
+    }
+
+    std::string body;
+    wwstorage::File file(input);
+    if (!file.GetContent(&body)) return false;
+    Json::Value root;
+    if (!wwstorage::JsonConveter::FromJsonString(body, &root)) return false;
+    for (int i = 0; i < root.size(); i++) {
+        wwstorage::StorageInfo info;
+        wwstorage::DataManager::FromJson(root[i], &info);
+        arr->push_back(info);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <input> <output> [binary|json]\n", argv[0]);
+        return 1;
+    }
+    log_system_module_init();
+    std::string format = argc > 3 ? argv[3] : "binary";
+
+    std::vector<wwstorage::StorageInfo> arr;
+    if (!LoadEntries(argv[1], &arr)) {
+        fprintf(stderr, "load %s failed\n", argv[1]);
+        return 1;
+    }
+
+    if (format == "binary") {
+        wwstorage::IndexWriter writer;
+        writer.Reserve(arr.size());
+        for (auto &e : arr) writer.Add(e.mtime_, e.atime_, e.fsize_, e.url_, e.storage_path_);
+        if (!writer.Write(argv[2])) return 1;
+    } else {
+        Json::Value root(Json::arrayValue);
+        for (auto &e : arr) {
+            Json::Value item;
+            wwstorage::DataManager::ToJson(e, &item);
+            root.append(item);
+        }
+        std::string body;
+        wwstorage::JsonConveter::ToString(root, &body);
+        wwstorage::File file(argv[2]);
+        if (!file.SetContent(body.c_str(), body.size())) return 1;
+    }
+    printf("converted %zu entries to %s\n", arr.size(), format.c_str());
+    return 0;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <event2/buffer.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "json_stream.hpp"
+#include "utils.hpp"
+
+namespace wwstorage {
+
+// 当前请求的追踪上下文，id 为 0 表示不在请求里（后台线程）；verbose 为 true 时输出这个请求的详细日志
+struct TraceContext {
+    uint64_t id;
+    bool verbose;
+};
+
+// 请求级追踪：每个阶段结束时把 {名字, 请求 id, 开始时间, 耗时} 写进本线程的环形缓冲区，
+// 缓冲区满了覆盖最旧的。写入只有几次 relaxed 原子写，没有锁也没有格式化；
+// 读取方（/debug/traces、SIGUSR1）用每个位置的序号判断读到的是不是完整的一条，和写入方不互相等待。
+// 输出 Chrome trace JSON，可以直接在 chrome://tracing 或 Perfetto 里打开
+class Tracer {
+public:
+    static Tracer &Instance()
+    {
+        static Tracer tracer;
+        return tracer;
+    }
+    // 每个线程保存最近 capacity 个 span，0 表示关闭；启动时调用一次
+    void Init(size_t capacity) { capacity_ = capacity; }
+    bool Enabled() const { return capacity_ > 0; }
+
+    // 请求开始时调用，verbose 来自请求头 X-Debug-Log: 1
+    TraceContext NewContext(bool verbose) { return {next_id_.fetch_add(1, std::memory_order_relaxed), verbose}; }
+    static TraceContext &Current()
+    {
+        thread_local TraceContext context = {0, false};
+        return context;
+    }
+    static bool Verbose() { return Current().verbose; }
+
+    // name 必须是静态字符串，时间是 Metrics::NowMicros 的返回值
+    void Record(const char *name, uint64_t start_us, uint64_t end_us)
+    {
+        if (capacity_ == 0) return;
+        Ring *ring = Local();
+        if (ring == nullptr) return;
+        uint64_t pos = ring->head.fetch_add(1, std::memory_order_relaxed);
+        Span &span = ring->spans[pos % capacity_];
+        span.seq.store(pos * 2 + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        span.name.store(name, std::memory_order_relaxed);
+        span.id.store(Current().id, std::memory_order_relaxed);
+        span.start.store(start_us, std::memory_order_relaxed);
+        span.duration.store(end_us - start_us, std::memory_order_relaxed);
+        span.seq.store(pos * 2 + 2, std::memory_order_release);
+    }
+
+    // 所有线程缓冲区里的 span，按 Chrome trace 的 complete 事件输出
+    void Render(evbuffer *out)
+    {
+        JsonStream json(out);
+        json.BeginObject();
+        json.Key("displayTimeUnit").String("ms");
+        json.Key("traceEvents").BeginArray();
+        int pid = getpid();
+        for (size_t tid = 0; tid < kRings; tid++) {
+            Ring *ring = rings_[tid].load(std::memory_order_acquire);
+            if (ring == nullptr) continue;
+            for (size_t i = 0; i < capacity_; i++) {
+                Span &span = ring->spans[i];
+                uint64_t seq = span.seq.load(std::memory_order_acquire);
+                const char *name = span.name.load(std::memory_order_relaxed);
+                uint64_t id = span.id.load(std::memory_order_relaxed);
+                uint64_t start = span.start.load(std::memory_order_relaxed);
+                uint64_t duration = span.duration.load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                // 没写过、正在写、或者读的过程中被覆盖了
+                if (seq == 0 || seq % 2 == 1 || span.seq.load(std::memory_order_relaxed) != seq) continue;
+                json.BeginObject();
+                json.Key("name").String(name);
+                json.Key("cat").String(id == 0 ? "background" : "request");
+                json.Key("ph").String("X");
+                json.Key("ts").Uint(start);
+                json.Key("dur").Uint(duration);
+                json.Key("pid").Int(pid);
+                json.Key("tid").Uint(tid);
+                json.Key("args").BeginObject().Key("request").Uint(id).EndObject();
+                json.EndObject();
+            }
+        }
+        json.EndArray();
+        json.EndObject();
+    }
+    // 写到 path，先写临时文件再 rename
+    bool Dump(const std::string &path)
+    {
+        evbuffer *buffer = evbuffer_new();
+        Render(buffer);
+        std::string tmp_path = path + ".tmp";
+        int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool ok = fd != -1;
+        while (ok && evbuffer_get_length(buffer) > 0) ok = evbuffer_write(buffer, fd) > 0;
+        if (fd != -1) close(fd);
+        evbuffer_free(buffer);
+        if (ok == false || rename(tmp_path.c_str(), path.c_str()) == -1) {
+            wwlog::GetLogger("asynclogger")->Error("dump traces to %s error: %s", path.c_str(), strerror(errno));
+            remove(tmp_path.c_str());
+            return false;
+        }
+        wwlog::GetLogger("asynclogger")->Info("traces dumped to %s", path.c_str());
+        return true;
+    }
+
+private:
+    static const size_t kRings = 64;
+
+    struct Span {
+        std::atomic<uint64_t> seq;  // 0 没写过，奇数正在写，偶数写完
+        std::atomic<const char *> name;
+        std::atomic<uint64_t> id;
+        std::atomic<uint64_t> start;
+        std::atomic<uint64_t> duration;
+    };
+    // 线程数超过 kRings 时几个线程共用一个，写位置用 fetch_add 分配，不会写到同一格
+    struct Ring {
+        explicit Ring(size_t capacity) : spans(new Span[capacity]), head(0)
+        {
+            for (size_t i = 0; i < capacity; i++) spans[i].seq = 0;
+        }
+        std::unique_ptr<Span[]> spans;
+        std::atomic<uint64_t> head;
+    };
+
+    Tracer() : capacity_(0), next_id_(1), next_ring_(0)
+    {
+        for (auto &ring : rings_) ring = nullptr;
+    }
+    // 每个线程第一次记录时分配缓冲区，之后不再释放
+    Ring *Local()
+    {
+        thread_local Ring *ring = nullptr;
+        if (ring) return ring;
+        size_t index = next_ring_.fetch_add(1) % kRings;
+        std::lock_guard<std::mutex> lock(mutex_);
+        ring = rings_[index].load(std::memory_order_relaxed);
+        if (ring == nullptr) {
+            ring = new Ring(capacity_);
+            rings_[index].store(ring, std::memory_order_release);
+        }
+        return ring;
+    }
+
+private:
+    size_t capacity_;  // Init 之后只读
+    std::atomic<uint64_t> next_id_;
+    std::atomic<size_t> next_ring_;
+    std::mutex mutex_;  // 只在分配缓冲区时用
+    std::atomic<Ring *> rings_[kRings];
+};
+
+// 在作用域内把 context 设为当前线程的追踪上下文，离开时恢复；
+// 跨线程的工作（codec 线程池、回到事件线程的回调）要把上下文带过去再开一个 TraceScope
+class TraceScope {
+public:
+    explicit TraceScope(const TraceContext &context) : saved_(Tracer::Current()) { Tracer::Current() = context; }
+    ~TraceScope() { Tracer::Current() = saved_; }
+
+private:
+    TraceContext saved_;
+};
+
+}  // namespace wwstorage
+
+// 请求的详细日志，只有请求带 X-Debug-Log: 1 时才格式化输出，前面加上请求 id
+#define REQUEST_LOG(fmt, ...)                                                                                  \
+    do {                                                                                                       \
+        if (wwstorage::Tracer::Verbose()) {                                                                    \
+            wwlog::GetLogger("asynclogger")                                                                    \
+                ->Info("[req %llu] " fmt, (unsigned long long)wwstorage::Tracer::Current().id, ##__VA_ARGS__); \
+        }                                                                                                      \
+    } while (0)
@@ -1,6 +1,10 @@
+#pragma once
+
 #include <assert.h>
+#include <fcntl.h>
 #include <jsoncpp/json/json.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include <filesystem>
 #include <iostream>
@@ -138,6 +142,22 @@ public:
         ofs.close();
         return true;
     }
+    // 把文件内容刷到磁盘
+    bool Sync()
+    {
+        int fd = open(file_name_.c_str(), O_RDONLY);
+        if (fd == -1) {
+            wwlog::GetLogger("asynclogger")->Info("%s, file open error: %s", file_name_.c_str(), strerror(errno));
+            return false;
+        }
+        int ret = fsync(fd);
+        close(fd);
+        if (ret == -1) {
+            wwlog::GetLogger("asynclogger")->Info("%s, file sync error: %s", file_name_.c_str(), strerror(errno));
+            return false;
+        }
+        return true;
+    }
     bool Compress(const std::string &content, int format)
     {
         std::string packed = bundle::pack(format, content);
@@ -190,10 +210,11 @@ private:
 
 class JsonConveter {
 public:
-    static bool ToString(const Json::Value &input, std::string *output)
+    static bool ToString(const Json::Value &input, std::string *output, bool compact = false)
     {
         Json::StreamWriterBuilder write_builder;
         write_builder["emitUTF8"] = true;
+        if (compact) write_builder["indentation"] = "";
         std::unique_ptr<Json::StreamWriter> writer(write_builder.newStreamWriter());
         std::stringstream json_stream;
         if (writer->write(input, &json_stream) != 0) {
@@ -209,8 +230,8 @@ public:
         Json::CharReaderBuilder read_builder;
         std::unique_ptr<Json::CharReader> reader(read_builder.newCharReader());
         std::string err;
-        if (reader->parse(input.c_str(), input.c_str() + input.size(), output, &err)) {
-            wwlog::GetLogger("asynclogger")->Info("parse error");
+        if (!reader->parse(input.c_str(), input.c_str() + input.size(), output, &err)) {
+            wwlog::GetLogger("asynclogger")->Info("parse error: %s", err.c_str());
             return false;
         }
         return true;